@@ -0,0 +1,593 @@
+/**
+ * @file benchDns.c
+ * @brief This file contains the benchmark harness of the DNS variant.
+ *
+ * A single MPI job sweeps matrix sizes and grid shapes: for every size the sequential kernel
+ * and every feasible q*q*m grid run a few warm-up repetitions and then the measured ones,
+ * so that process startup never ends up in the numbers. The matrices are generated in memory,
+ * the input time covers the scatter of the blocks along layer 0 and the computation time
+ * covers distribution, Cannon steps and reduction, as in dnsVariant.
+ *
+ * For every size a CSV file with the same schema written by script.sh (median times) is
+ * saved in the measurements folder, with one row per number of processes: the sequential
+ * kernel for one process and the fastest correct grid for the others. A second CSV holds
+ * the full statistics of every grid.
+ *
+ * With -a the benchmark also works as autotuner: the fastest grid of each size is measured
+ * again with several sizes of the kernel panels, and the best configuration is stored in the
+ * tuning file, where dnsVariant finds it when the grid is not given on the command line.
+ *
+ * @author Cezar Narcis Culcea
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "mpi.h"
+#include "inOutUtils.h"
+#include "gemmKernel.h"
+#include "dnsEngine.h"
+#include "tuningCache.h"
+
+/**
+ * @struct Summary
+ * @brief Statistics of the repetitions of a measurement.
+ */
+typedef struct {
+    double median; /**< Median time */
+    double p10; /**< 10th percentile */
+    double p90; /**< 90th percentile */
+    double mean; /**< Mean time */
+} Summary;
+
+/**
+ * @brief Computes the statistics of a set of samples.
+ *
+ * @param samples Samples, sorted in place.
+ * @param count Number of samples.
+ * @param summary Pointer to the statistics to fill.
+ */
+void summarize(double* samples, int count, Summary* summary);
+
+/**
+ * @brief Times the sequential kernel on proc 0.
+ *
+ * @param matrixA First matrix, n*n.
+ * @param matrixB Second matrix, n*n.
+ * @param matrixC Result matrix, n*n.
+ * @param n Size of the matrices.
+ * @param warmup Number of repetitions not measured.
+ * @param reps Number of measured repetitions.
+ * @param inputTimes Array of reps elements receiving the input times.
+ * @param calcTimes Array of reps elements receiving the computation times.
+ */
+void benchSequential(elem_t* matrixA, elem_t* matrixB, elem_t* matrixC, int n, int warmup, int reps, double* inputTimes, double* calcTimes);
+
+/**
+ * @brief Times the DNS variant on a q*q*m grid.
+ *
+ * This is a collective operation over MPI_COMM_WORLD: the processes outside the grid
+ * only wait for the others.
+ *
+ * @param blocksA First matrix split in blocks, on proc 0.
+ * @param blocksB Second matrix split in blocks, on proc 0.
+ * @param reference Sequential result, on proc 0, used to check the last repetition.
+ * @param n Size of the matrices.
+ * @param q Side of each layer of the grid.
+ * @param m Number of layers of the grid.
+ * @param engine Strategy used for the shifts.
+ * @param distribution Strategy used to place the blocks.
+ * @param warmup Number of repetitions not measured.
+ * @param reps Number of measured repetitions.
+ * @param inputTimes Array of reps elements receiving the input times, on proc 0.
+ * @param calcTimes Array of reps elements receiving the computation times, on proc 0.
+ * @return On proc 0, 1 if the result matches the reference and 0 otherwise.
+ */
+int benchGrid(elem_t* blocksA, elem_t* blocksB, elem_t* reference, int n, int q, int m, enum Engine engine, enum DistributionMode distribution, int warmup, int reps, double* inputTimes, double* calcTimes);
+
+/**
+ * @brief Searches the sizes of the kernel panels for a grid.
+ *
+ * This is a collective operation over MPI_COMM_WORLD. Every candidate is timed like a grid
+ * of the sweep; candidates that cannot change the tiling of the b*b local products are
+ * skipped. The kernel is left with its default panels.
+ *
+ * @param matrixA First matrix, on proc 0.
+ * @param matrixB Second matrix, on proc 0.
+ * @param reference Sequential result, on proc 0.
+ * @param n Size of the matrices.
+ * @param engine Strategy used for the shifts.
+ * @param distribution Strategy used to place the blocks.
+ * @param warmup Number of repetitions not measured.
+ * @param reps Number of measured repetitions.
+ * @param inputTimes Array of reps elements used for the input times.
+ * @param calcTimes Array of reps elements used for the computation times.
+ * @param best Configuration with the grid to tune and the time of the default panels, updated on proc 0.
+ */
+void tuneTiles(elem_t* matrixA, elem_t* matrixB, elem_t* reference, int n, enum Engine engine, enum DistributionMode distribution, int warmup, int reps, double* inputTimes, double* calcTimes, TuningEntry* best);
+
+/**
+ * @brief The main function of the benchmark.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv An array of strings containing the command-line arguments.
+ * @return 0 on success.
+ */
+int main(int argc, char* argv[]){
+    int myRank; /**< The rank of the current process */
+    int p; /**< The total number of processes */
+    int warmup = 2; /**< Repetitions not measured */
+    int reps = 10; /**< Measured repetitions */
+    int opt; /**< Current command-line option */
+    int threadSupport; /**< Thread support level provided by MPI */
+    int autotune = 0; /**< Whether the best configurations are stored in the tuning file */
+    char* folder = "measurements"; /**< Folder of the CSV files */
+    enum Engine engine = ENGINE_CANNON; /**< Strategy used for the shifts */
+    enum DistributionMode distribution = DISTRIBUTION_BCAST; /**< Strategy used to place the blocks */
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    while((opt = getopt(argc, argv, "w:r:o:e:d:a")) != -1){
+        switch(opt){
+            case 'w':
+                warmup = strtol(optarg, NULL, 10);
+                break;
+            case 'r':
+                reps = strtol(optarg, NULL, 10);
+                break;
+            case 'o':
+                folder = optarg;
+                break;
+            case 'e':
+                if(!strcmp(optarg, "cannon")) engine = ENGINE_CANNON;
+                else if(!strcmp(optarg, "pipelined")) engine = ENGINE_PIPELINED;
+                else if(!strcmp(optarg, "25d")) engine = ENGINE_25D;
+                else if(!strcmp(optarg, "shm")) engine = ENGINE_SHM;
+                else if(!strcmp(optarg, "rma")) engine = ENGINE_RMA;
+                else reps = 0;
+                break;
+            case 'd':
+                if(!strcmp(optarg, "bcast")) distribution = DISTRIBUTION_BCAST;
+                else if(!strcmp(optarg, "fused")) distribution = DISTRIBUTION_FUSED;
+                else reps = 0;
+                break;
+            case 'a':
+                autotune = 1;
+                break;
+            default:
+                reps = 0;
+                break;
+        }
+    }
+
+    if((optind == argc || reps < 1 || warmup < 0) && !myRank){
+        printf("Abort... usage ./benchDns [-w warmup] [-r repetitions] [-o folder] [-e cannon|pipelined|25d|shm|rma] [-d bcast|fused] [-a] size...\n\n");
+        fflush(stdout);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%d%m%Y_%H%M", localtime(&now));
+
+    FILE* details = NULL;
+    if(!myRank){
+        if(mkdir(folder, 0755) && errno != EEXIST){
+            printf("Abort... cannot create %s\n\n", folder);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        char filename[512];
+        snprintf(filename, sizeof(filename), "%s/BENCH_%s.csv", folder, timestamp);
+        details = fopen(filename, "w");
+        if(details == NULL){
+            printf("Abort... cannot create %s\n\n", filename);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        fprintf(details, "Size;q;m;Proc;Input Median;Calc Median;Calc P10;Calc P90;Calc Mean;GFLOPS;Speedup;Correct\n");
+        printf("%6s %4s %4s %6s %12s %12s %12s %12s %9s %8s\n", "size", "q", "m", "procs", "input", "calc", "p10", "p90", "GFLOP/s", "speedup");
+    }
+
+    double* inputTimes = malloc(reps*sizeof(double));
+    double* calcTimes = malloc(reps*sizeof(double));
+
+    for(int arg = optind; arg < argc; arg++){
+        int n = strtol(argv[arg], NULL, 10);
+        if(n < 1) continue;
+        double flops = 2.0*n*n*n;
+        elem_t* matrixA = NULL, *matrixB = NULL, *reference = NULL;
+        FILE* summaryFile = NULL;
+        Summary seqInput, seq, input, calc;
+        double* fastestInput = NULL; /**< Input median of the fastest correct grid for each number of processes */
+        double* fastestCalc = NULL; /**< Calc median of the fastest correct grid for each number of processes, -1 if none */
+        TuningEntry best = {0, 0, 0, 0, 0, -1}; /**< Fastest correct grid */
+
+        /****************************** SEQUENTIAL ************************************/
+        if(!myRank){
+            matrixA = malloc((size_t)n*n*sizeof(elem_t));
+            matrixB = malloc((size_t)n*n*sizeof(elem_t));
+            reference = malloc((size_t)n*n*sizeof(elem_t));
+            if(matrixA==NULL || matrixB==NULL || reference==NULL){
+                printf("Abort... error allocating memory.\n");
+                MPI_Abort(MPI_COMM_WORLD, 2);
+            }
+            generateMatrix(matrixA, matrixB, n);
+            benchSequential(matrixA, matrixB, reference, n, warmup, reps, inputTimes, calcTimes);
+            summarize(inputTimes, reps, &seqInput);
+            summarize(calcTimes, reps, &seq);
+
+            fastestInput = malloc((p + 1)*sizeof(double));
+            fastestCalc = malloc((p + 1)*sizeof(double));
+            if(fastestInput==NULL || fastestCalc==NULL){
+                printf("Abort... error allocating memory.\n");
+                MPI_Abort(MPI_COMM_WORLD, 2);
+            }
+            for(int procs = 0; procs <= p; procs++) fastestCalc[procs] = -1;
+
+            //Same schema as the measurements of script.sh
+            char filename[512];
+            snprintf(filename, sizeof(filename), "%s/SIZE%d_%s.csv", folder, n, timestamp);
+            summaryFile = fopen(filename, "w");
+            if(summaryFile != NULL){
+                fprintf(summaryFile, "Measurements matrix SIZE %d * %d\n", n, n);
+                fprintf(summaryFile, "Proc;Input Time;Calc Time\n");
+                fprintf(summaryFile, "%d;%10.6f;%10.6f\n", 1, seqInput.median, seq.median);
+            }
+            fprintf(details, "%d;%d;%d;%d;%.9f;%.9f;%.9f;%.9f;%.9f;%.3f;%.3f;%d\n", n, 0, 0, 1,
+                    seqInput.median, seq.median, seq.p10, seq.p90, seq.mean, flops / seq.median * 1e-9, 1.0, 1);
+            printf("%6d %4s %4s %6d %12.6f %12.6f %12.6f %12.6f %9.3f %8.3f\n", n, "-", "-", 1,
+                   seqInput.median, seq.median, seq.p10, seq.p90, flops / seq.median * 1e-9, 1.0);
+            fflush(stdout);
+        }
+
+        /****************************** GRID SHAPES ************************************/
+        for(int q = 1; q <= n && q*q <= p; q++){
+            int b = (n + q - 1) / q;
+            if((q - 1) * b >= n) continue; //The last row of blocks would be only padding
+
+            elem_t* blocksA = NULL, *blocksB = NULL;
+            if(!myRank){
+                blocksA = malloc((size_t)q*q*b*b*sizeof(elem_t));
+                blocksB = malloc((size_t)q*q*b*b*sizeof(elem_t));
+                if(blocksA==NULL || blocksB==NULL){
+                    printf("Abort... error allocating memory.\n");
+                    MPI_Abort(MPI_COMM_WORLD, 2);
+                }
+                matrixToBlocks(matrixA, blocksA, n, q);
+                matrixToBlocks(matrixB, blocksB, n, q);
+            }
+
+            for(int m = 1; m <= q && q*q*m <= p; m++){
+                if(q % m) continue;
+                int correct = benchGrid(blocksA, blocksB, reference, n, q, m, engine, distribution, warmup, reps, inputTimes, calcTimes);
+                if(myRank) continue;
+
+                summarize(inputTimes, reps, &input);
+                summarize(calcTimes, reps, &calc);
+                //The SIZE file keeps one row per number of processes, the sequential kernel stands for one
+                if(correct && q*q*m > 1 && (fastestCalc[q*q*m] < 0 || calc.median < fastestCalc[q*q*m])){
+                    fastestInput[q*q*m] = input.median;
+                    fastestCalc[q*q*m] = calc.median;
+                }
+                fprintf(details, "%d;%d;%d;%d;%.9f;%.9f;%.9f;%.9f;%.9f;%.3f;%.3f;%d\n", n, q, m, q*q*m,
+                        input.median, calc.median, calc.p10, calc.p90, calc.mean,
+                        flops / calc.median * 1e-9, seq.median / calc.median, correct);
+                printf("%6d %4d %4d %6d %12.6f %12.6f %12.6f %12.6f %9.3f %8.3f%s\n", n, q, m, q*q*m,
+                       input.median, calc.median, calc.p10, calc.p90,
+                       flops / calc.median * 1e-9, seq.median / calc.median, correct ? "" : "  ERRORE");
+                fflush(stdout);
+                if(correct && (best.time < 0 || calc.median < best.time)){
+                    best.q = q;
+                    best.m = m;
+                    best.time = calc.median;
+                }
+            }
+
+            free(blocksA);
+            free(blocksB);
+        }
+
+        /****************************** AUTOTUNER ************************************/
+        if(autotune){
+            MPI_Bcast(&best, sizeof(TuningEntry), MPI_BYTE, 0, MPI_COMM_WORLD);
+            if(best.time >= 0){
+                tuneTiles(matrixA, matrixB, reference, n, engine, distribution, warmup, reps, inputTimes, calcTimes, &best);
+            }
+            if(!myRank && best.time >= 0){
+                char machine[TUNING_MACHINE_LEN];
+                tuningMachine(machine);
+                if(storeTuning(TUNING_FILE, machine, n, p, engine, distribution, &best)){
+                    printf("Impossibile scrivere %s\n", TUNING_FILE);
+                }else{
+                    printf("Tuning %s n=%d p=%d: griglia %dx%dx%d, pannelli %d %d %d, %.6f s\n", machine, n, p,
+                           best.q, best.q, best.m, best.mc, best.kc, best.nc, best.time);
+                }
+                fflush(stdout);
+            }
+        }
+
+        if(!myRank){
+            if(summaryFile != NULL){
+                for(int procs = 2; procs <= p; procs++){
+                    if(fastestCalc[procs] >= 0) fprintf(summaryFile, "%d;%10.6f;%10.6f\n", procs, fastestInput[procs], fastestCalc[procs]);
+                }
+                fclose(summaryFile);
+            }
+            free(fastestInput);
+            free(fastestCalc);
+            free(matrixA);
+            free(matrixB);
+            free(reference);
+        }
+    }
+
+    if(!myRank) fclose(details);
+    free(inputTimes);
+    free(calcTimes);
+    MPI_Finalize();
+    return 0;
+}
+
+/**
+ * @brief Compares two doubles, for qsort.
+ *
+ * @param a Pointer to the first double.
+ * @param b Pointer to the second double.
+ * @return Negative, zero or positive as a is smaller, equal or larger than b.
+ */
+static int compareDoubles(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Returns a percentile of sorted samples, interpolating between the closest ones.
+ *
+ * @param sorted The sorted samples.
+ * @param count The number of samples.
+ * @param fraction The percentile, between 0 and 1.
+ * @return The percentile.
+ */
+static double percentile(double* sorted, int count, double fraction){
+    double position = fraction * (count - 1);
+    int below = (int)position;
+    if(below >= count - 1) return sorted[count - 1];
+    return sorted[below] + (position - below) * (sorted[below + 1] - sorted[below]);
+}
+
+/**
+ * @brief Computes the statistics of a set of samples.
+ *
+ * @param samples The samples, sorted in place.
+ * @param count The number of samples.
+ * @param summary Pointer to the statistics to fill.
+ */
+void summarize(double* samples, int count, Summary* summary){
+    double sum = 0;
+    qsort(samples, count, sizeof(double), compareDoubles);
+    for(int i = 0; i < count; i++) sum += samples[i];
+    summary->median = percentile(samples, count, 0.5);
+    summary->p10 = percentile(samples, count, 0.1);
+    summary->p90 = percentile(samples, count, 0.9);
+    summary->mean = sum / count;
+}
+
+/**
+ * @brief Times the sequential kernel on proc 0.
+ *
+ * The other processes are not involved, they wait for proc 0 in the next collective.
+ * As the grids receive their blocks with the scatter, the kernel works on its own copy
+ * of the matrices, and the copy is the input time.
+ *
+ * @param matrixA The first matrix.
+ * @param matrixB The second matrix.
+ * @param matrixC The result matrix.
+ * @param n The size of the matrices.
+ * @param warmup The number of repetitions not measured.
+ * @param reps The number of measured repetitions.
+ * @param inputTimes The array receiving the input times.
+ * @param calcTimes The array receiving the computation times.
+ */
+void benchSequential(elem_t* matrixA, elem_t* matrixB, elem_t* matrixC, int n, int warmup, int reps, double* inputTimes, double* calcTimes){
+    elem_t* localA = malloc((size_t)n*n*sizeof(elem_t));
+    elem_t* localB = malloc((size_t)n*n*sizeof(elem_t));
+    if(localA==NULL || localB==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    for(int i = -warmup; i < reps; i++){
+        double start = MPI_Wtime();
+        memcpy(localA, matrixA, (size_t)n*n*sizeof(elem_t));
+        memcpy(localB, matrixB, (size_t)n*n*sizeof(elem_t));
+        double copied = MPI_Wtime();
+        memset(matrixC, 0, (size_t)n*n*sizeof(elem_t));
+        gemmKernel(localA, localB, matrixC, n, n, n, n, n, n);
+        double end = MPI_Wtime();
+        if(i >= 0){
+            inputTimes[i] = copied - start;
+            calcTimes[i] = end - copied;
+        }
+    }
+
+    free(localA);
+    free(localB);
+}
+
+/**
+ * @brief Searches the sizes of the kernel panels for a grid.
+ *
+ * The candidates cover panels of A from half to twice the default, depths from 128 to 512
+ * and two widths of the panel of B. A panel larger than the local block behaves like the
+ * block itself, so two candidates that clamp to the same panels are timed only once.
+ * Only proc 0 knows the times, and it keeps the best configuration.
+ *
+ * @param matrixA The first matrix.
+ * @param matrixB The second matrix.
+ * @param reference The sequential result.
+ * @param n The size of the matrices.
+ * @param engine The strategy used for the shifts.
+ * @param distribution The strategy used to place the blocks.
+ * @param warmup The number of repetitions not measured.
+ * @param reps The number of measured repetitions.
+ * @param inputTimes The array used for the input times.
+ * @param calcTimes The array used for the computation times.
+ * @param best The configuration to improve.
+ */
+void tuneTiles(elem_t* matrixA, elem_t* matrixB, elem_t* reference, int n, enum Engine engine, enum DistributionMode distribution, int warmup, int reps, double* inputTimes, double* calcTimes, TuningEntry* best){
+    static const int mcCandidates[] = {GEMM_MC / 2, GEMM_MC, GEMM_MC * 2};
+    static const int kcCandidates[] = {128, 256, 512};
+    static const int ncCandidates[] = {1024, GEMM_NC};
+    int tried[3*3*2][3];
+    int triedCount = 0;
+    int myRank;
+    int q = best->q, m = best->m;
+    int b = (n + q - 1) / q;
+    elem_t* blocksA = NULL, *blocksB = NULL;
+    Summary calc;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    gemmGetTiles(&best->mc, &best->kc, &best->nc);
+    if(!myRank){
+        blocksA = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        blocksB = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        if(blocksA==NULL || blocksB==NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        matrixToBlocks(matrixA, blocksA, n, q);
+        matrixToBlocks(matrixB, blocksB, n, q);
+    }
+
+    for(int i = 0; i < 3; i++){
+        for(int k = 0; k < 3; k++){
+            for(int j = 0; j < 2; j++){
+                int mc = mcCandidates[i], kc = kcCandidates[k], nc = ncCandidates[j];
+                //Panels are never larger than the block
+                int used[3] = {mc < b ? mc : b, kc < b ? kc : b, nc < b ? nc : b};
+                int seen = 0;
+                for(int t = 0; t < triedCount; t++){
+                    if(!memcmp(tried[t], used, sizeof(used))) seen = 1;
+                }
+                if(seen) continue;
+                memcpy(tried[triedCount++], used, sizeof(used));
+
+                gemmSetTiles(mc, kc, nc);
+                int correct = benchGrid(blocksA, blocksB, reference, n, q, m, engine, distribution, warmup, reps, inputTimes, calcTimes);
+                if(myRank) continue;
+
+                summarize(calcTimes, reps, &calc);
+                printf("%6d %4d %4d   mc=%-4d kc=%-4d nc=%-5d %12.6f%s\n", n, q, m, mc, kc, nc, calc.median, correct ? "" : "  ERRORE");
+                fflush(stdout);
+                if(correct && calc.median < best->time){
+                    gemmGetTiles(&best->mc, &best->kc, &best->nc);
+                    best->time = calc.median;
+                }
+            }
+        }
+    }
+
+    gemmSetTiles(0, 0, 0);
+    free(blocksA);
+    free(blocksB);
+}
+
+/**
+ * @brief Times the DNS variant on a q*q*m grid.
+ *
+ * The grid is built once and reused by every repetition. Each repetition scatters the
+ * blocks from proc 0 (input time), then distributes, multiplies and reduces them
+ * (computation time); barriers delimit the phases as in dnsVariant. After the last
+ * repetition C is gathered on proc 0 and compared with the sequential result.
+ *
+ * @param blocksA The first matrix split in blocks.
+ * @param blocksB The second matrix split in blocks.
+ * @param reference The sequential result.
+ * @param n The size of the matrices.
+ * @param q The side of each layer of the grid.
+ * @param m The number of layers of the grid.
+ * @param engine The strategy used for the shifts.
+ * @param distribution The strategy used to place the blocks.
+ * @param warmup The number of repetitions not measured.
+ * @param reps The number of measured repetitions.
+ * @param inputTimes The array receiving the input times.
+ * @param calcTimes The array receiving the computation times.
+ * @return On proc 0, 1 if the result matches the reference and 0 otherwise.
+ */
+int benchGrid(elem_t* blocksA, elem_t* blocksB, elem_t* reference, int n, int q, int m, enum Engine engine, enum DistributionMode distribution, int warmup, int reps, double* inputTimes, double* calcTimes){
+    int myRank;
+    int correct = 1;
+    MPI_Comm commActive;
+    DnsContext ctx;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_split(MPI_COMM_WORLD, myRank < q*q*m ? 0 : MPI_UNDEFINED, myRank, &commActive);
+    if(commActive == MPI_COMM_NULL){
+        MPI_Barrier(MPI_COMM_WORLD);
+        return 0;
+    }
+
+    createDnsContext(&ctx, commActive, n, q, m, engine, distribution);
+    int b = ctx.b;
+    elem_t* finalC = malloc(b*b*sizeof(elem_t));
+    elem_t* localC = malloc(b*b*sizeof(elem_t));
+
+    for(int i = -warmup; i < reps; i++){
+        elem_t* localA = malloc(b*b*sizeof(elem_t));
+        elem_t* localB = malloc(b*b*sizeof(elem_t));
+        if(localA==NULL || localB==NULL || localC==NULL || finalC==NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        memset(localC, 0, b*b*sizeof(elem_t));
+
+        MPI_Barrier(commActive);
+        double start = MPI_Wtime();
+        if(ctx.coords[Z] == 0){
+            MPI_Scatter(blocksA, b*b, MPI_ELEM, localA, b*b, MPI_ELEM, 0, ctx.comms.commXYplanes);
+            MPI_Scatter(blocksB, b*b, MPI_ELEM, localB, b*b, MPI_ELEM, 0, ctx.comms.commXYplanes);
+        }
+        MPI_Barrier(commActive);
+        double scattered = MPI_Wtime();
+
+        distributeBlocks(&ctx, &localA, &localB);
+        multiplyBlocks(&ctx, localA, localB, localC);
+        MPI_Reduce(localC, finalC, b*b, MPI_ELEM, MPI_SUM, 0, ctx.comms.commZsingleDim);
+        MPI_Barrier(commActive);
+        double end = MPI_Wtime();
+
+        if(i >= 0){
+            inputTimes[i] = scattered - start;
+            calcTimes[i] = end - scattered;
+        }
+    }
+
+    //Check the last result against the sequential kernel
+    elem_t* blocksC = NULL;
+    if(!myRank) blocksC = malloc((size_t)q*q*b*b*sizeof(elem_t));
+    if(ctx.coords[Z] == 0){
+        MPI_Gather(finalC, b*b, MPI_ELEM, blocksC, b*b, MPI_ELEM, 0, ctx.comms.commXYplanes);
+    }
+    if(!myRank){
+        elem_t* matrixC = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        blocksToMatrix(blocksC, matrixC, n, q);
+        correct = !memcmp(matrixC, reference, (size_t)n*n*sizeof(elem_t));
+        free(matrixC);
+        free(blocksC);
+    }
+
+    free(localC);
+    free(finalC);
+    freeDnsContext(&ctx);
+    MPI_Comm_free(&commActive);
+    MPI_Barrier(MPI_COMM_WORLD);
+    return correct;
+}
@@ -31,12 +31,10 @@ int main(int argc, char* argv[]){
     int p;
     int n;
 
-    int* matrixA = NULL;
-    int* matrixB = NULL;
-    int* matrixC = NULL;
-    int localA;
-    int localB;
-    int localC;
+    elem_t* matrixC = NULL;
+    elem_t localA;
+    elem_t localB;
+    elem_t localC;
 
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
@@ -53,21 +51,6 @@ int main(int argc, char* argv[]){
     /* Start the timer */
     MPI_Barrier(MPI_COMM_WORLD);
     total_time = -MPI_Wtime();
-    /************************** GENERAZIONE MATRICI ************************************/
-    if(!myRank){//Solo il processo 0 genera le matrici
-        matrixA = malloc(n*n*sizeof(int));
-        matrixB = malloc(n*n*sizeof(int));
-
-        if(matrixA==NULL || matrixB==NULL){
-            printf("Abort... error allocating memory.\n");
-            MPI_Abort(MPI_COMM_WORLD, 2);
-        }        
-        
-        generateMatrix(matrixA, matrixB, n); //Genero le matrici
-    }
-
-    MPI_Barrier(MPI_COMM_WORLD);
-    input_time = total_time + MPI_Wtime();
     /****************************** COMUNICATORI ************************************/
     struct Communicators* comms;
     comms = malloc(sizeof(struct Communicators));
@@ -81,43 +64,42 @@ int main(int argc, char* argv[]){
 
     createCommunicators(comms, dims, periods, &cartRank, cartCoords);
     
-    /****************************** SCATTER MATRICI ************************************/
+    /************************** GENERAZIONE MATRICI ************************************/
 
-    /* Il processo root invia in scatter un elemento della matrice ad ogni processo del livello 0*/
+    /* Ogni processo del livello 0 genera il proprio elemento di A e di B, senza scatter:
+       il generatore dipende solo da riga e colonna, quindi i valori sono quelli di generateMatrix */
     if(cartCoords[Z] == 0){
-        MPI_Scatter(matrixA, 1, MPI_INT, &localA, 1, MPI_INT, 0, comms->commXYplanes); 
-        MPI_Scatter(matrixB, 1, MPI_INT, &localB, 1, MPI_INT, 0, comms->commXYplanes);
+        generateMatrixTile(MATRIX_A, cartCoords[X], cartCoords[Y], 1, 1, &localA, 1);
+        generateMatrixTile(MATRIX_B, cartCoords[X], cartCoords[Y], 1, 1, &localB, 1);
     }
 
-    if(!myRank){ //Solo il processo 0 libera le matrici
-        free(matrixA);
-        free(matrixB);
-    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    input_time = total_time + MPI_Wtime();
 
     /****************************** BCAST COLONNE DI A ************************************/
-    MPI_Bcast(&localA, 1, MPI_INT, 0, comms->commZsingleDim);
+    MPI_Bcast(&localA, 1, MPI_ELEM, 0, comms->commZsingleDim);
 
     /****************************** BCAST RIGHE DI B ************************************/
-    MPI_Bcast(&localB, 1, MPI_INT, 0, comms->commZsingleDim);
+    MPI_Bcast(&localB, 1, MPI_ELEM, 0, comms->commZsingleDim);
 
     /****************************** BCAST A LUNGO LE RIGHE ************************************/
-    MPI_Bcast(&localA, 1, MPI_INT, cartCoords[Z], comms->commYsingleDim);
+    MPI_Bcast(&localA, 1, MPI_ELEM, cartCoords[Z], comms->commYsingleDim);
 
     /******************************* BCAST B LUNGO COLONNE ************************************/
-    MPI_Bcast(&localB, 1, MPI_INT, cartCoords[Z], comms->commXsingleDim);
+    MPI_Bcast(&localB, 1, MPI_ELEM, cartCoords[Z], comms->commXsingleDim);
 
     /****************************** CALCOLO ************************************/
     localC = localA * localB;
     
     /****************************** REDUCE C LOCALE ************************************/
-    int finalC;
-    MPI_Reduce(&localC, &finalC, 1, MPI_INT, MPI_SUM, 0, comms->commZsingleDim);
+    elem_t finalC;
+    MPI_Reduce(&localC, &finalC, 1, MPI_ELEM, MPI_SUM, 0, comms->commZsingleDim);
 
     /****************************** GATHER C ************************************/
-    if(!myRank) matrixC = malloc(n*n*sizeof(int));
+    if(!myRank) matrixC = malloc(n*n*sizeof(elem_t));
 
     if(cartCoords[Z] == 0){
-        MPI_Gather(&finalC, 1, MPI_INT, matrixC, 1, MPI_INT, 0, comms->commXYplanes);
+        MPI_Gather(&finalC, 1, MPI_ELEM, matrixC, 1, MPI_ELEM, 0, comms->commXYplanes);
     }
 
     /* Stop the timer */
@@ -0,0 +1,758 @@
+/**
+ * @file dnsEngine.c
+ * @brief This file contains the distributed multiplication engine of the DNS variant.
+ *
+ * The grid has q*q*m processes. Layer 0 starts with the blocks of A and B, which are
+ * broadcast along Z and inside the layers so that layer z holds the columns of A and the
+ * rows of B of its share of the inner dimension. Every layer is split in m*m submatrices
+ * of side q/m, where Cannon's algorithm computes the partial product of the layer.
+ *
+ * @author Cezar Narcis Culcea
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dnsEngine.h"
+#include "gemmKernel.h"
+#include "phaseProfiler.h"
+
+/**
+ * @brief Builds the q*q*m process grid and its communicators.
+ * 
+ * @param ctx Pointer to the context to initialize.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param n The size of the matrices.
+ * @param q The side of each layer of the grid.
+ * @param m The number of layers of the grid.
+ * @param engine The strategy used for the shifts.
+ * @param distribution The strategy used to place the blocks.
+ */
+void createDnsContext(DnsContext* ctx, MPI_Comm parent, int n, int q, int m, enum Engine engine, enum DistributionMode distribution){
+    int dims[3] = {0, 0, 0};
+    dims[X] = q;
+    dims[Y] = q;
+    dims[Z] = m;
+    int periods[3] = {0, 0, 0};
+
+    ctx->n = n;
+    ctx->q = q;
+    ctx->m = m;
+    ctx->b = (n + q - 1) / q;
+    ctx->engine = engine;
+    ctx->distribution = distribution;
+    createCommunicators(&ctx->comms, parent, dims, periods, &ctx->cartRank, ctx->coords, q/m);
+    if(engine == ENGINE_CANNON || engine == ENGINE_PIPELINED || engine == ENGINE_25D){
+        //The shifts of every product go around the same neighbours, inside the submatrices or the whole layer
+        AdjacentCells adj;
+        int planeRank;
+        MPI_Comm_rank(ctx->comms.commXYplanes, &planeRank);
+        findAdjacentCells(planeRank, q, engine == ENGINE_25D ? 1 : m, 1, 1, &adj);
+        createShiftPlan(&ctx->shifts, ctx->b*ctx->b, &adj, ctx->comms.commXYplanes);
+    }
+    if(engine == ENGINE_SHM) createSharedBlocks(ctx);
+    if(engine == ENGINE_RMA){
+        //A single window over the grid, living as long as it in a passive epoch open on every process
+        MPI_Win_allocate((MPI_Aint)2*ctx->b*ctx->b*sizeof(elem_t), sizeof(elem_t), MPI_INFO_NULL, ctx->comms.commCart, &ctx->rmaBlocks, &ctx->rmaWindow);
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, ctx->rmaWindow);
+    }
+}
+
+/**
+ * @brief Frees the communicators of a context.
+ * 
+ * @param ctx Pointer to the context to free.
+ */
+void freeDnsContext(DnsContext* ctx){
+    if(ctx->engine == ENGINE_CANNON || ctx->engine == ENGINE_PIPELINED || ctx->engine == ENGINE_25D){
+        freeShiftPlan(&ctx->shifts);
+    }
+    if(ctx->engine == ENGINE_SHM) freeSharedBlocks(&ctx->shared);
+    if(ctx->engine == ENGINE_RMA){
+        MPI_Win_unlock_all(ctx->rmaWindow);
+        MPI_Win_free(&ctx->rmaWindow);
+    }
+    MPI_Comm_free(&ctx->comms.commSubMatrixX);
+    MPI_Comm_free(&ctx->comms.commSubMatrixY);
+    MPI_Comm_free(&ctx->comms.commXsingleDim);
+    MPI_Comm_free(&ctx->comms.commYsingleDim);
+    MPI_Comm_free(&ctx->comms.commZsingleDim);
+    MPI_Comm_free(&ctx->comms.commXYplanes);
+    MPI_Comm_free(&ctx->comms.commYZplanes);
+    MPI_Comm_free(&ctx->comms.commZXplanes);
+    MPI_Comm_free(&ctx->comms.commCart);
+}
+
+/**
+ * @brief Brings the blocks of layer 0 to their aligned position in the grid.
+ * 
+ * With the broadcast distribution A and B are first copied to every layer along Z, then
+ * broadcast inside each layer from the process whose column (for A) or row (for B) matches
+ * the layer, and finally aligned for Cannon inside the submatrices. The fused distribution
+ * does all of it in one step.
+ * 
+ * The 2.5D engine only needs the copies along Z: every layer then skews its whole plane
+ * as in Cannon, with layer z starting z*q/m steps ahead, so that the m layers run
+ * disjoint ranges of the q steps.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA Pointer to the block of A.
+ * @param localB Pointer to the block of B.
+ */
+void distributeBlocks(DnsContext* ctx, elem_t** localA, elem_t** localB){
+    struct Communicators* comms = &ctx->comms;
+    int* cartCoords = ctx->coords;
+    int q = ctx->q;
+    int m = ctx->m;
+    int b = ctx->b;
+    double blockBytes = (double)b*b*sizeof(elem_t);
+
+    if(ctx->engine == ENGINE_SHM){
+        //The blocks stay on layer 0, the other processes read them from there
+        sharedDistribution(ctx, *localA, *localB);
+        return;
+    }
+
+    if(ctx->distribution == DISTRIBUTION_FUSED){
+        /****************************** FUSED DISTRIBUTION ************************************/
+        phaseBegin(PHASE_FUSED);
+        fusedDistribution(localA, localB, b*b, q, m, ctx->engine, cartCoords, comms->commCart);
+        phaseEnd(PHASE_FUSED, 2*blockBytes);
+        return;
+    }
+
+    /****************************** BCAST A Columns ************************************/
+    phaseBegin(PHASE_BCAST_A_Z);
+    MPI_Bcast(*localA, b*b, MPI_ELEM, 0, comms->commZsingleDim);
+    phaseEnd(PHASE_BCAST_A_Z, blockBytes);
+
+    /****************************** BCAST B Rows ************************************/
+    phaseBegin(PHASE_BCAST_B_Z);
+    MPI_Bcast(*localB, b*b, MPI_ELEM, 0, comms->commZsingleDim);
+    phaseEnd(PHASE_BCAST_B_Z, blockBytes);
+
+    if(ctx->engine == ENGINE_25D){
+        //Skew of the whole layer, offset by the steps run by the layers below: the process
+        //(z, y, x) starts from the inner index (x + y + z*q/m) % q
+        int x = cartCoords[X];
+        int y = cartCoords[Y];
+        int offset = cartCoords[Z]*(q/m);
+        int shiftA = (y + offset) % q;
+        int shiftB = (x + offset) % q;
+        phaseBegin(PHASE_ALIGN);
+        MPI_Sendrecv_replace(*localA, b*b, MPI_ELEM, y*q + (x - shiftA + q) % q, 0, y*q + (x + shiftA) % q, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
+        MPI_Sendrecv_replace(*localB, b*b, MPI_ELEM, ((y - shiftB + q) % q)*q + x, 0, ((y + shiftB) % q)*q + x, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
+        phaseEnd(PHASE_ALIGN, 2*blockBytes);
+        return;
+    }
+
+    /****************************** BCAST A values over their rows in each layer, if layer = col ************************************/
+    phaseBegin(PHASE_BCAST_A_X);
+    MPI_Bcast(*localA, b*b, MPI_ELEM, cartCoords[Z], comms->commSubMatrixX);
+    phaseEnd(PHASE_BCAST_A_X, blockBytes);
+
+    /******************************* BCAST B  values over their cols in each layer, if layer = row ************************************/
+    phaseBegin(PHASE_BCAST_B_Y);
+    MPI_Bcast(*localB, b*b, MPI_ELEM, cartCoords[Z], comms->commSubMatrixY);
+    phaseEnd(PHASE_BCAST_B_Y, blockBytes);
+
+    //Initial alignment
+    AdjacentCells adj;
+    int planeRank;
+    MPI_Comm_rank(comms->commXYplanes, &planeRank);
+    int rigaSubMatrix = cartCoords[Y] % (q/m);
+    int colonnaSubMatrix = cartCoords[X] % (q/m);
+    findAdjacentCells(planeRank, q, m, rigaSubMatrix, colonnaSubMatrix, &adj);
+    phaseBegin(PHASE_ALIGN);
+    MPI_Sendrecv_replace(*localA, b*b, MPI_ELEM, adj.left, 0, adj.right, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
+    MPI_Sendrecv_replace(*localB, b*b, MPI_ELEM, adj.up, 0, adj.down, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
+    phaseEnd(PHASE_ALIGN, 2*blockBytes);
+}
+
+/**
+ * @brief Runs the Cannon steps of the layer and accumulates the partial product.
+ * 
+ * The shifts are the persistent requests of the context, replayed at every step: the
+ * blocks are copied into the first buffers of the plan, which stay bound to the requests.
+ * The cannon engine shifts after each multiplication, the pipelined engine starts the
+ * shifts before it, so that the blocks for step i+1 travel while step i is multiplied.
+ * The 2.5D engine shifts in the same way as the pipelined one, but around the whole layer
+ * instead of inside the submatrices. The shm and rma engines do not shift, see sharedMultiply
+ * and rmaMultiply.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA The block of A, freed by the function.
+ * @param localB The block of B, freed by the function.
+ * @param localC The block of C where the product is accumulated.
+ */
+void multiplyBlocks(DnsContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC){
+    int q = ctx->q;
+    int m = ctx->m;
+    int b = ctx->b;
+    double blockBytes = (double)b*b*sizeof(elem_t);
+
+    if(ctx->engine == ENGINE_SHM){
+        sharedMultiply(ctx, localC);
+        free(localA);
+        free(localB);
+        return;
+    }
+    if(ctx->engine == ENGINE_RMA){
+        rmaMultiply(ctx, localA, localB, localC);
+        return;
+    }
+
+    ShiftPlan* plan = &ctx->shifts;
+    memcpy(plan->bufferA[0], localA, b*b*sizeof(elem_t));
+    memcpy(plan->bufferB[0], localB, b*b*sizeof(elem_t));
+    free(localA);
+    free(localB);
+    int current = 0; //Index of the buffers holding the blocks of the current step
+    for(int i=0; i<q/m; i++){
+        int shift = i < q/m - 1; //The blocks used in the last step do not need to move
+        //The pipelined engine lets the blocks for step i+1 travel while step i is multiplied
+        if(shift && ctx->engine != ENGINE_CANNON) MPI_Startall(4, plan->requests[current]);
+        phaseBegin(PHASE_COMPUTE);
+        gemmKernel(plan->bufferA[current], plan->bufferB[current], localC, b, b, b, b, b, b);
+        phaseEnd(PHASE_COMPUTE, 0);
+        if(shift){
+            //With the pipelined engine only the wait not hidden by the multiplication is timed
+            phaseBegin(PHASE_SHIFT);
+            if(ctx->engine == ENGINE_CANNON) MPI_Startall(4, plan->requests[current]);
+            MPI_Waitall(4, plan->requests[current], MPI_STATUSES_IGNORE);
+            phaseEnd(PHASE_SHIFT, 2*blockBytes);
+            current = 1 - current;
+        }
+    }
+}
+
+/**
+ * @brief Creates communicators for the given dimensions and periods.
+ * 
+ * This function creates communicators for a Cartesian topology with the specified dimensions and periods.
+ * It also creates sub-communicators for different planes and single dimensions.
+ * Additionally, it splits the communicator based on the coordinates and a discriminant color.
+ * 
+ * @param comms Pointer to the struct containing the communicators.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param dims Array of dimensions for the Cartesian topology.
+ * @param periods Array of periods for the Cartesian topology.
+ * @param cartRank Pointer to the variable storing the rank in the Cartesian communicator.
+ * @param coords Pointer to the array storing the coordinates in the Cartesian communicator.
+ * @param discriminanteColore The discriminant color used for splitting the communicator in submatrices.
+ */
+void createCommunicators(struct Communicators* comms, MPI_Comm parent, int* dims, int* periods, int* cartRank, int* coords, int discriminanteColore){
+    MPI_Cart_create(parent, 3, dims, periods, 0, &comms->commCart);
+    MPI_Comm_rank(comms->commCart, cartRank);
+    MPI_Cart_coords(comms->commCart, *cartRank, 3, coords);
+    int remaining_dims[3] = {0, 0, 0};
+
+    remaining_dims[X] = 1;
+    remaining_dims[Y] = 1;
+    remaining_dims[Z] = 0;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commXYplanes);
+
+    remaining_dims[X] = 0;
+    remaining_dims[Y] = 1;
+    remaining_dims[Z] = 1;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commYZplanes);
+
+    remaining_dims[X] = 1;
+    remaining_dims[Y] = 0;
+    remaining_dims[Z] = 1;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commZXplanes);
+
+    remaining_dims[X] = 1;
+    remaining_dims[Y] = 0;
+    remaining_dims[Z] = 0;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commXsingleDim);
+
+    remaining_dims[X] = 0;
+    remaining_dims[Y] = 1;
+    remaining_dims[Z] = 0;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commYsingleDim);
+
+    remaining_dims[X] = 0;
+    remaining_dims[Y] = 0;
+    remaining_dims[Z] = 1;
+    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commZsingleDim);
+    //These communicators include all the processes in the same row, that have the same rank inside all'submatrices
+    int color = coords[X] % discriminanteColore;
+    MPI_Comm_split(comms->commXsingleDim, color, *cartRank, &comms->commSubMatrixX);
+    //These communicators include all the processes in the same col, that have the same rank inside all'submatrices
+    color = coords[Y] % discriminanteColore;
+    MPI_Comm_split(comms->commYsingleDim, color, *cartRank, &comms->commSubMatrixY);
+}
+
+/**
+ * @brief Finds the indices of the adjacent cells in a grid with wrap-around.
+ * 
+ * This function calculates the indices of the adjacent cells in a grid with wrap-around.
+ * The grid has dimensions (n/m)^2, and the distance between adjacent cells in the x and y directions is specified.
+ * The indices of the adjacent cells are stored in the AdjacentCells struct.
+ * The indices used to get cells position in matrix use a cartesian style indexing, not the usual row, col indexing.
+ * 
+ * @param index The index of the current cell.
+ * @param n The number of cells in the x direction.
+ * @param m The number of cells in the y direction.
+ * @param distX The distance between adjacent cells in the x direction.
+ * @param distY The distance between adjacent cells in the y direction.
+ * @param adj Pointer to the struct storing the indices of the adjacent cells.
+ */
+void findAdjacentCells(int index, int n, int m, int distX, int distY, AdjacentCells *adj) {
+    int sm_size = n / m;  // submatrix size
+    int x = index % n;    // coord x cell
+    int y = index / n;    // coord y cell
+
+    // Get offset due to submatrix
+    int sub_x = x / sm_size * sm_size;
+    int sub_y = y / sm_size * sm_size;
+
+    // Get adjacent cells coordinate in submatrix with wrap around
+    int up_x = x;
+    int up_y = (y - distY + sm_size) % sm_size + sub_y;
+    adj->up = up_y * n + up_x;
+
+    int down_x = x;
+    int down_y = (y + distY) % sm_size + sub_y;
+    adj->down = down_y * n + down_x;
+
+    int left_x = (x - distX + sm_size) % sm_size + sub_x;
+    int left_y = y;
+    adj->left = left_y * n + left_x;
+
+    int right_x = (x + distX) % sm_size + sub_x;
+    int right_y = y;
+    adj->right = right_y * n + right_x;
+}
+
+/**
+ * @brief Delivers to every process its aligned blocks of A and B in a single step.
+ * 
+ * With s = q/m, after the broadcasts and the initial alignment the process (z, y, x) holds
+ * A(y, k) and B(k, x) with k = z*s + (x%s + y%s)%s, that is the blocks owned in layer 0 by
+ * (0, y, k) and (0, k, x). Conversely the block A(y, c) of layer 0 goes to the m processes
+ * of layer c/s and row y whose column satisfies (x%s + y%s)%s = c%s, and B(r, x) to the
+ * m processes of layer r/s and column x whose row satisfies the same relation with r.
+ * 
+ * These edges form a distributed graph on which a single MPI_Neighbor_alltoallw moves all
+ * the blocks. The displacements are absolute addresses from MPI_BOTTOM, so A and B travel
+ * in the same call without being copied in a common buffer. When the same pair of processes
+ * exchanges both blocks, the A edge comes first on both sides and keeps them apart.
+ * 
+ * With the 2.5D engine the process (z, y, x) holds A(y, k) and B(k, x) with
+ * k = (x + y + z*s) % q instead, so A(y, c) goes to the process of row y and column
+ * (c - y - z*s) mod q of every layer z, and B(r, x) to the one of column x and row
+ * (r - x - z*s) mod q.
+ * 
+ * @param localA Pointer to the block of A, replaced by the aligned one.
+ * @param localB Pointer to the block of B, replaced by the aligned one.
+ * @param count Number of elements of each block.
+ * @param q The side of each layer of the procs cube.
+ * @param m The depth of procs cube.
+ * @param engine The engine, which decides where the aligned blocks are.
+ * @param coords The Cartesian coordinates of the current process.
+ * @param commCart The Cartesian communicator.
+ */
+void fusedDistribution(elem_t** localA, elem_t** localB, int count, int q, int m, enum Engine engine, int* coords, MPI_Comm commCart){
+    int s = q / m;
+    int sources[2];
+    int* destinations = malloc(2*m*sizeof(int));
+    int outdegree = 0;
+    int target[3];
+
+    //Where the aligned blocks of this process come from
+    int k = coords[Z]*s + (coords[X]%s + coords[Y]%s) % s;
+    if(engine == ENGINE_25D) k = (coords[X] + coords[Y] + coords[Z]*s) % q;
+    target[Z] = 0;
+    target[Y] = coords[Y];
+    target[X] = k;
+    MPI_Cart_rank(commCart, target, &sources[0]);
+    target[Y] = k;
+    target[X] = coords[X];
+    MPI_Cart_rank(commCart, target, &sources[1]);
+
+    //Where the blocks of layer 0 have to go
+    if(coords[Z] == 0 && engine == ENGINE_25D){
+        for(int i = 0; i < m; i++){
+            target[Z] = i;
+            target[Y] = coords[Y];
+            target[X] = ((coords[X] - coords[Y] - i*s) % q + q) % q;
+            MPI_Cart_rank(commCart, target, &destinations[outdegree++]);
+        }
+        for(int i = 0; i < m; i++){
+            target[Z] = i;
+            target[Y] = ((coords[Y] - coords[X] - i*s) % q + q) % q;
+            target[X] = coords[X];
+            MPI_Cart_rank(commCart, target, &destinations[outdegree++]);
+        }
+    }else if(coords[Z] == 0){
+        target[Z] = coords[X] / s;
+        target[Y] = coords[Y];
+        for(int i = 0; i < m; i++){
+            target[X] = i*s + (coords[X]%s - coords[Y]%s + s) % s;
+            MPI_Cart_rank(commCart, target, &destinations[outdegree++]);
+        }
+        target[Z] = coords[Y] / s;
+        target[X] = coords[X];
+        for(int i = 0; i < m; i++){
+            target[Y] = i*s + (coords[Y]%s - coords[X]%s + s) % s;
+            MPI_Cart_rank(commCart, target, &destinations[outdegree++]);
+        }
+    }
+
+    elem_t* alignedA = malloc(count*sizeof(elem_t));
+    elem_t* alignedB = malloc(count*sizeof(elem_t));
+    int* sendCounts = malloc(2*m*sizeof(int));
+    MPI_Aint* sendDispls = malloc(2*m*sizeof(MPI_Aint));
+    MPI_Datatype* sendTypes = malloc(2*m*sizeof(MPI_Datatype));
+    if(destinations==NULL || alignedA==NULL || alignedB==NULL || sendCounts==NULL || sendDispls==NULL || sendTypes==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    int recvCounts[2] = {count, count};
+    MPI_Aint recvDispls[2];
+    MPI_Datatype recvTypes[2] = {MPI_ELEM, MPI_ELEM};
+    for(int i = 0; i < outdegree; i++){
+        sendCounts[i] = count;
+        sendTypes[i] = MPI_ELEM;
+        MPI_Get_address(i < m ? *localA : *localB, &sendDispls[i]);
+    }
+    MPI_Get_address(alignedA, &recvDispls[0]);
+    MPI_Get_address(alignedB, &recvDispls[1]);
+
+    //The edges are weighted with the elements they carry
+    MPI_Comm commGraph;
+    MPI_Dist_graph_create_adjacent(commCart, 2, sources, recvCounts, outdegree, destinations, sendCounts, MPI_INFO_NULL, 0, &commGraph);
+
+    MPI_Neighbor_alltoallw(MPI_BOTTOM, sendCounts, sendDispls, sendTypes, MPI_BOTTOM, recvCounts, recvDispls, recvTypes, commGraph);
+
+    MPI_Comm_free(&commGraph);
+    free(sendCounts);
+    free(sendDispls);
+    free(sendTypes);
+    free(destinations);
+    free(*localA);
+    free(*localB);
+    *localA = alignedA;
+    *localB = alignedB;
+}
+
+/**
+ * @brief Sets up the persistent requests for the Cannon shifts.
+ * 
+ * A blocks move right and B blocks move down inside the submatrices, as in the original
+ * MPI_Sendrecv_replace loop. Distinct tags keep the two operands apart when the right
+ * and the lower neighbour are the same process.
+ * 
+ * @param plan Pointer to the plan to initialize.
+ * @param count Number of elements of each block.
+ * @param adj Pointer to the adjacent cells at distance one.
+ * @param comm Communicator of the plane.
+ */
+void createShiftPlan(ShiftPlan* plan, int count, AdjacentCells* adj, MPI_Comm comm){
+    for(int i = 0; i < 2; i++){
+        plan->bufferA[i] = malloc(count*sizeof(elem_t));
+        plan->bufferB[i] = malloc(count*sizeof(elem_t));
+        if(plan->bufferA[i]==NULL || plan->bufferB[i]==NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+    }
+
+    for(int i = 0; i < 2; i++){
+        MPI_Recv_init(plan->bufferA[1-i], count, MPI_ELEM, adj->left, 0, comm, &plan->requests[i][0]);
+        MPI_Recv_init(plan->bufferB[1-i], count, MPI_ELEM, adj->up, 1, comm, &plan->requests[i][1]);
+        MPI_Send_init(plan->bufferA[i], count, MPI_ELEM, adj->right, 0, comm, &plan->requests[i][2]);
+        MPI_Send_init(plan->bufferB[i], count, MPI_ELEM, adj->down, 1, comm, &plan->requests[i][3]);
+    }
+}
+
+/**
+ * @brief Frees the persistent requests and the buffers of a plan.
+ * 
+ * @param plan Pointer to the plan to free.
+ */
+void freeShiftPlan(ShiftPlan* plan){
+    for(int i = 0; i < 2; i++){
+        for(int j = 0; j < 4; j++) MPI_Request_free(&plan->requests[i][j]);
+        free(plan->bufferA[i]);
+        free(plan->bufferB[i]);
+    }
+}
+
+/**
+ * @brief Allocates the shared window of the shm engine and finds the slots on the node.
+ * 
+ * The processes of the grid on the same node share a window where each process of layer 0
+ * owns a slot of 2*b*b elements, and the others an empty one. The slots are laid out
+ * separately, so that every one can sit in the memory close to its owner. The window stays
+ * in a passive epoch for its whole life, and MPI_Win_sync orders the accesses.
+ * 
+ * @param ctx Pointer to the context.
+ */
+void createSharedBlocks(DnsContext* ctx){
+    SharedBlocks* shared = &ctx->shared;
+    int q = ctx->q;
+    int b = ctx->b;
+    MPI_Info info;
+    MPI_Group groupCart, groupNode;
+
+    MPI_Comm_split_type(ctx->comms.commCart, MPI_COMM_TYPE_SHARED, ctx->cartRank, MPI_INFO_NULL, &shared->commNode);
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Aint slotBytes = ctx->coords[Z] == 0 ? (MPI_Aint)2*b*b*sizeof(elem_t) : 0;
+    MPI_Win_allocate_shared(slotBytes, sizeof(elem_t), info, shared->commNode, &shared->own, &shared->window);
+    MPI_Info_free(&info);
+    if(!slotBytes) shared->own = NULL;
+
+    int size = q*q*ctx->m;
+    int* ranks = malloc(size*sizeof(int));
+    shared->nodeRanks = malloc(size*sizeof(int));
+    shared->slots = malloc(q*q*sizeof(elem_t*));
+    if(ranks==NULL || shared->nodeRanks==NULL || shared->slots==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+    for(int i = 0; i < size; i++) ranks[i] = i;
+    MPI_Comm_group(ctx->comms.commCart, &groupCart);
+    MPI_Comm_group(shared->commNode, &groupNode);
+    MPI_Group_translate_ranks(groupCart, size, ranks, groupNode, shared->nodeRanks);
+    MPI_Group_free(&groupCart);
+    MPI_Group_free(&groupNode);
+    free(ranks);
+
+    //The processes of layer 0 are the first q*q ranks of the Cartesian communicator
+    for(int i = 0; i < q*q; i++){
+        shared->slots[i] = NULL;
+        if(shared->nodeRanks[i] != MPI_UNDEFINED){
+            MPI_Aint slotSize;
+            int dispUnit;
+            MPI_Win_shared_query(shared->window, shared->nodeRanks[i], &slotSize, &dispUnit, &shared->slots[i]);
+        }
+    }
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shared->window);
+}
+
+/**
+ * @brief Frees the shared window of the shm engine.
+ * 
+ * @param shared Pointer to the window to free.
+ */
+void freeSharedBlocks(SharedBlocks* shared){
+    MPI_Win_unlock_all(shared->window);
+    MPI_Win_free(&shared->window);
+    MPI_Comm_free(&shared->commNode);
+    free(shared->nodeRanks);
+    free(shared->slots);
+}
+
+/**
+ * @brief Publishes the blocks of layer 0 in the shared window.
+ * 
+ * Layer 0 copies its blocks in its slot; after the barrier every process of the node
+ * sees them, so the broadcasts and the alignment are not needed.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA The block of A.
+ * @param localB The block of B.
+ */
+void sharedDistribution(DnsContext* ctx, elem_t* localA, elem_t* localB){
+    SharedBlocks* shared = &ctx->shared;
+    size_t count = (size_t)ctx->b*ctx->b;
+
+    phaseBegin(PHASE_ALIGN);
+    if(shared->own != NULL){
+        memcpy(shared->own, localA, count*sizeof(elem_t));
+        memcpy(shared->own + count, localB, count*sizeof(elem_t));
+    }
+    MPI_Win_sync(shared->window);
+    MPI_Barrier(shared->commNode);
+    MPI_Win_sync(shared->window);
+    phaseEnd(PHASE_ALIGN, 0);
+}
+
+/**
+ * @brief Runs the steps of the layer on the published blocks and accumulates the partial product.
+ * 
+ * With s = q/m, at step i the process (z, y, x) multiplies A(y, k) by B(k, x) with
+ * k = z*s + (x + y + i) % s, the blocks published by (0, y, k) and (0, k, x). A block
+ * published on the same node is multiplied in place. The others are sent by their owner
+ * at the start, all of them at once, and received one step ahead in two buffers per
+ * operand, so only the traffic between nodes goes through messages.
+ * 
+ * A(y, c) is used by the q processes (c/s, y, x) and B(r, x) by the q processes (r/s, y, x):
+ * the owners send to those on other nodes. The owner waits for its sends, and the node for
+ * its readers, before the slots can be overwritten by the next product.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localC The block of C where the product is accumulated.
+ */
+void sharedMultiply(DnsContext* ctx, elem_t* localC){
+    SharedBlocks* shared = &ctx->shared;
+    MPI_Comm commCart = ctx->comms.commCart;
+    int q = ctx->q;
+    int s = q / ctx->m;
+    int b = ctx->b;
+    int x = ctx->coords[X];
+    int y = ctx->coords[Y];
+    int z = ctx->coords[Z];
+    int count = b*b;
+    int sends = 0;
+    int target[3];
+
+    elem_t* bufferA[2] = {malloc(count*sizeof(elem_t)), malloc(count*sizeof(elem_t))};
+    elem_t* bufferB[2] = {malloc(count*sizeof(elem_t)), malloc(count*sizeof(elem_t))};
+    MPI_Request* sendRequests = malloc(2*q*sizeof(MPI_Request));
+    MPI_Request requests[2][2] = {{MPI_REQUEST_NULL, MPI_REQUEST_NULL}, {MPI_REQUEST_NULL, MPI_REQUEST_NULL}};
+    elem_t* blockA[2]; /**< Blocks of A of the current and next step */
+    elem_t* blockB[2]; /**< Blocks of B of the current and next step */
+    if(bufferA[0]==NULL || bufferA[1]==NULL || bufferB[0]==NULL || bufferB[1]==NULL || sendRequests==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    //The owners send their blocks to the users on other nodes
+    if(shared->own != NULL){
+        for(int i = 0; i < q; i++){
+            int rank;
+            target[Z] = x / s;
+            target[Y] = y;
+            target[X] = i;
+            MPI_Cart_rank(commCart, target, &rank);
+            if(shared->nodeRanks[rank] == MPI_UNDEFINED){
+                MPI_Isend(shared->own, count, MPI_ELEM, rank, 0, commCart, &sendRequests[sends++]);
+            }
+            target[Z] = y / s;
+            target[Y] = i;
+            target[X] = x;
+            MPI_Cart_rank(commCart, target, &rank);
+            if(shared->nodeRanks[rank] == MPI_UNDEFINED){
+                MPI_Isend(shared->own + count, count, MPI_ELEM, rank, 1, commCart, &sendRequests[sends++]);
+            }
+        }
+    }
+
+    for(int i = 0; i <= s; i++){
+        int next = i % 2; //Buffers of step i, prepared at iteration i
+        if(i < s){
+            int k = z*s + (x + y + i) % s;
+            int ownerA = y*q + k; //Rank of (0, y, k)
+            int ownerB = k*q + x; //Rank of (0, k, x)
+            blockA[next] = shared->slots[ownerA];
+            blockB[next] = shared->slots[ownerB] != NULL ? shared->slots[ownerB] + count : NULL;
+            if(blockA[next] == NULL){
+                blockA[next] = bufferA[next];
+                MPI_Irecv(bufferA[next], count, MPI_ELEM, ownerA, 0, commCart, &requests[next][0]);
+            }
+            if(blockB[next] == NULL){
+                blockB[next] = bufferB[next];
+                MPI_Irecv(bufferB[next], count, MPI_ELEM, ownerB, 1, commCart, &requests[next][1]);
+            }
+        }
+        if(i == 0) continue;
+
+        //Step i-1 runs while the blocks of step i travel
+        int current = (i - 1) % 2;
+        double received = (requests[current][0] != MPI_REQUEST_NULL) + (requests[current][1] != MPI_REQUEST_NULL);
+        phaseBegin(PHASE_SHIFT);
+        MPI_Waitall(2, requests[current], MPI_STATUSES_IGNORE);
+        phaseEnd(PHASE_SHIFT, received*count*sizeof(elem_t));
+        phaseBegin(PHASE_COMPUTE);
+        gemmKernel(blockA[current], blockB[current], localC, b, b, b, b, b, b);
+        phaseEnd(PHASE_COMPUTE, 0);
+    }
+
+    MPI_Waitall(sends, sendRequests, MPI_STATUSES_IGNORE);
+    MPI_Barrier(shared->commNode);
+
+    free(sendRequests);
+    for(int i = 0; i < 2; i++){
+        free(bufferA[i]);
+        free(bufferB[i]);
+    }
+}
+
+/**
+ * @brief Runs the Cannon steps of the layer with one-sided gets instead of the shifts.
+ * 
+ * The whole schedule is known in advance: at step i the process holds the blocks that
+ * after the alignment were i cells to its left (for A) and above it (for B) inside its
+ * submatrix. Every process copies its aligned blocks in its window and, after a single
+ * barrier of the layer, fetches with MPI_Rget the blocks of up to RMA_LOOKAHEAD steps
+ * ahead, each in its own buffer. A buffer is reused for a new get as soon as its step is
+ * multiplied, so the processes never wait for each other during the steps; the barrier at
+ * the end keeps the windows unchanged until every get has completed.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA The block of A after the initial alignment, freed by the function.
+ * @param localB The block of B after the initial alignment, freed by the function.
+ * @param localC The block of C where the product is accumulated.
+ */
+void rmaMultiply(DnsContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC){
+    MPI_Comm commPlane = ctx->comms.commXYplanes;
+    int q = ctx->q;
+    int m = ctx->m;
+    int s = q / m;
+    int b = ctx->b;
+    int count = b*b;
+    int depth = s - 1 < RMA_LOOKAHEAD ? s - 1 : RMA_LOOKAHEAD;
+    double blockBytes = (double)count*sizeof(elem_t);
+    int planeRank;
+    int layer = ctx->coords[Z]*q*q; //Rank in the grid of the first process of the layer
+    AdjacentCells adj;
+    MPI_Comm_rank(commPlane, &planeRank);
+
+    elem_t* buffers = malloc((size_t)2*(depth > 0 ? depth : 1)*count*sizeof(elem_t)); /**< A and B of every step in flight */
+    MPI_Request* requests = malloc(2*(depth > 0 ? depth : 1)*sizeof(MPI_Request));
+    if(buffers==NULL || requests==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    //Publish the aligned blocks
+    memcpy(ctx->rmaBlocks, localA, count*sizeof(elem_t));
+    memcpy(ctx->rmaBlocks + count, localB, count*sizeof(elem_t));
+    free(localA);
+    free(localB);
+    MPI_Win_sync(ctx->rmaWindow);
+    MPI_Barrier(commPlane);
+
+    //The blocks of step j go in slot (j - 1) % depth
+    for(int j = 1; j <= depth; j++){
+        int slot = j - 1;
+        findAdjacentCells(planeRank, q, m, j, j, &adj);
+        MPI_Rget(buffers + (size_t)2*slot*count, count, MPI_ELEM, layer + adj.left, 0, count, MPI_ELEM, ctx->rmaWindow, &requests[2*slot]);
+        MPI_Rget(buffers + (size_t)(2*slot + 1)*count, count, MPI_ELEM, layer + adj.up, count, count, MPI_ELEM, ctx->rmaWindow, &requests[2*slot + 1]);
+    }
+
+    for(int i = 0; i < s; i++){
+        elem_t* blockA = ctx->rmaBlocks;
+        elem_t* blockB = ctx->rmaBlocks + count;
+        int slot = depth > 0 ? (i - 1) % depth : 0;
+        if(i > 0){
+            phaseBegin(PHASE_SHIFT);
+            MPI_Waitall(2, &requests[2*slot], MPI_STATUSES_IGNORE);
+            phaseEnd(PHASE_SHIFT, 2*blockBytes);
+            blockA = buffers + (size_t)2*slot*count;
+            blockB = buffers + (size_t)(2*slot + 1)*count;
+        }
+
+        phaseBegin(PHASE_COMPUTE);
+        gemmKernel(blockA, blockB, localC, b, b, b, b, b, b);
+        phaseEnd(PHASE_COMPUTE, 0);
+
+        //The slot just multiplied receives the blocks of step i + depth
+        if(i > 0 && i + depth < s){
+            findAdjacentCells(planeRank, q, m, i + depth, i + depth, &adj);
+            MPI_Rget(blockA, count, MPI_ELEM, layer + adj.left, 0, count, MPI_ELEM, ctx->rmaWindow, &requests[2*slot]);
+            MPI_Rget(blockB, count, MPI_ELEM, layer + adj.up, count, count, MPI_ELEM, ctx->rmaWindow, &requests[2*slot + 1]);
+        }
+    }
+
+    MPI_Barrier(commPlane);
+    free(buffers);
+    free(requests);
+}
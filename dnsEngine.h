@@ -0,0 +1,287 @@
+/**
+ * @file dnsEngine.h
+ * @brief Header file containing the distributed multiplication engine of the DNS variant.
+ *
+ * The engine owns the process grid and its communicators, places the blocks of A and B
+ * on the grid and multiplies them. Reading the inputs and delivering the result are left
+ * to the caller, so that the same grid can serve many products.
+ */
+
+#ifndef DNSENGINE_H
+#define DNSENGINE_H
+
+#include "mpi.h"
+#include "matrixType.h"
+
+#define X 2 /**< The X dimension index */
+#define Y 1 /**< The Y dimension index */
+#define Z 0 /**< The Z dimension index */
+
+/**
+ * @enum Engine
+ * @brief Strategies available for the Cannon shifts of the compute phase.
+ */
+enum Engine{
+    ENGINE_CANNON, /**< Shifts started and completed after every multiplication */
+    ENGINE_PIPELINED, /**< Nonblocking double-buffered shifts overlapped with the multiplication */
+    ENGINE_25D, /**< 2.5D schedule: every layer runs q/m pipelined steps of a Cannon over the whole layer */
+    ENGINE_SUMMA, /**< Panel broadcasts on a rectangular 2D grid, see summaEngine.h */
+    ENGINE_SHM, /**< Blocks of layer 0 read in place through a shared window, messages only between nodes */
+    ENGINE_RMA /**< One-sided gets of the blocks of the next steps from the window of their owners */
+};
+
+/**
+ * @def RMA_LOOKAHEAD
+ * @brief Steps whose blocks the rma engine fetches ahead of the multiplication.
+ */
+#define RMA_LOOKAHEAD 3
+
+/**
+ * @enum DistributionMode
+ * @brief Ways of bringing the blocks from layer 0 to their aligned position in the grid.
+ */
+enum DistributionMode{
+    DISTRIBUTION_BCAST, /**< Four broadcasts followed by the initial alignment */
+    DISTRIBUTION_FUSED /**< A single neighbourhood all-to-all delivering the aligned blocks */
+};
+
+/**
+ * @struct Communicators
+ * @brief Struct to store different MPI communicators.
+ *
+ * This struct stores different MPI communicators used for communication between processes in different dimensions.
+ */
+struct Communicators{
+    MPI_Comm commCart; /**< Communicator for X, Y, and Z dimensions */
+    MPI_Comm commXYplanes; /**< Communicator for horizontal planes */
+    MPI_Comm commYZplanes; /**< Communicator for vertical lateral planes */
+    MPI_Comm commZXplanes; /**< Communicator for front vertical planes */
+    MPI_Comm commXsingleDim; /**< Communicator for processes along X with fixed YZ */
+    MPI_Comm commYsingleDim; /**< Communicator for processes along Y with fixed XZ */
+    MPI_Comm commZsingleDim; /**< Communicator for processes along Z with fixed XY */
+    MPI_Comm commSubMatrixX; /**< Communicator for processes along X with equal rank modulo n/m */
+    MPI_Comm commSubMatrixY; /**< Communicator for processes along Y with equal rank modulo n/m */
+};
+
+/**
+ * @struct AdjacentCells
+ * @brief Struct to store information about adjacent cells.
+ *
+ * This struct stores the rank of the adjacent cells in the Cartesian communicator.
+ */
+typedef struct {
+    int up; /**< Rank of the cell above (with wrap around) in the submatrices */
+    int down; /**< Rank of the cell below (with wrap around) in the submatrices */
+    int left; /**< Rank of the cell to the left (with wrap around) in the submatrices */
+    int right; /**< Rank of the cell to the right (with wrap around) in the submatrices */
+} AdjacentCells;
+
+/**
+ * @struct ShiftPlan
+ * @brief Struct to store the persistent requests of the Cannon shifts.
+ *
+ * The neighbours never change with the grid, so the shifts are set up once per context
+ * and replayed at every step of every product with MPI_Startall. Two buffers per operand
+ * are used: requests[i] sends bufferA[i] and bufferB[i] and receives into the other buffers.
+ */
+typedef struct {
+    elem_t* bufferA[2]; /**< Current and next block of A */
+    elem_t* bufferB[2]; /**< Current and next block of B */
+    MPI_Request requests[2][4]; /**< Persistent requests, indexed by the buffer being sent */
+} ShiftPlan;
+
+/**
+ * @struct SharedBlocks
+ * @brief Node-level shared window of the shm engine.
+ *
+ * Every process of layer 0 publishes its blocks of A and B in the window, the processes
+ * of the same node read them in place and the others receive them as messages.
+ */
+typedef struct {
+    MPI_Comm commNode; /**< Processes of the grid sharing the memory of the node */
+    MPI_Win window; /**< Window with A and B of the processes of layer 0 on the node */
+    elem_t* own; /**< Slot of the process, A followed by B on layer 0, NULL elsewhere */
+    int* nodeRanks; /**< Rank in commNode of every process of the grid, MPI_UNDEFINED if on another node */
+    elem_t** slots; /**< Slot of every process of layer 0, NULL if on another node */
+} SharedBlocks;
+
+/**
+ * @struct DnsContext
+ * @brief Process grid of the DNS variant, built once and reused by every product.
+ */
+typedef struct {
+    struct Communicators comms; /**< Communicators of the grid */
+    int cartRank; /**< The rank of the current process in the Cartesian communicator */
+    int coords[3]; /**< The Cartesian coordinates of the current process */
+    int n; /**< The dimension of the matrices */
+    int q; /**< The side of each layer of the procs cube */
+    int m; /**< The depth of procs cube */
+    int b; /**< The side of the block owned by each process */
+    enum Engine engine; /**< Strategy used for the shifts */
+    enum DistributionMode distribution; /**< Strategy used to place the blocks */
+    SharedBlocks shared; /**< Shared window, only with the shm engine */
+    MPI_Win rmaWindow; /**< Window over the grid exposing the aligned blocks, only with the rma engine */
+    elem_t* rmaBlocks; /**< Memory of the window of the process, aligned A followed by aligned B */
+    ShiftPlan shifts; /**< Persistent shifts and their buffers, only with the cannon, pipelined and 25d engines */
+} DnsContext;
+
+/**
+ * @brief Builds the q*q*m process grid and its communicators.
+ * 
+ * This is a collective operation over parent, which must have exactly q*q*m processes.
+ * 
+ * @param ctx Pointer to the context to initialize.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param n Size of the matrices.
+ * @param q Side of each layer of the grid.
+ * @param m Number of layers of the grid, a divisor of q.
+ * @param engine Strategy used for the shifts.
+ * @param distribution Strategy used to place the blocks.
+ */
+void createDnsContext(DnsContext* ctx, MPI_Comm parent, int n, int q, int m, enum Engine engine, enum DistributionMode distribution);
+
+/**
+ * @brief Frees the communicators of a context.
+ * 
+ * @param ctx Pointer to the context to free.
+ */
+void freeDnsContext(DnsContext* ctx);
+
+/**
+ * @brief Brings the blocks of layer 0 to their aligned position in the grid.
+ * 
+ * On input the processes of layer 0 hold the blocks A(y, x) and B(y, x), on output every
+ * process holds the blocks of its first Cannon step. The blocks may be reallocated.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA Pointer to the block of A.
+ * @param localB Pointer to the block of B.
+ */
+void distributeBlocks(DnsContext* ctx, elem_t** localA, elem_t** localB);
+
+/**
+ * @brief Runs the Cannon steps of the layer and accumulates the partial product.
+ * 
+ * The blocks must come from distributeBlocks; they are moved around by the shifts
+ * and freed before returning.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA Block of A, freed by the function.
+ * @param localB Block of B, freed by the function.
+ * @param localC Block of C, of at least b*b elements, where the product is accumulated.
+ */
+void multiplyBlocks(DnsContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC);
+
+/**
+ * @brief Create different communicators for the program.
+ *
+ * This function creates different MPI communicators based on the given dimensions, periods, and ranks.
+ * It also takes a discriminanteColore parameter to determine the color of the processes in the communicators.
+ *
+ * @param comms Pointer to the struct to store the created communicators.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param dims Array of dimensions for the Cartesian grid.
+ * @param periods Array of periods for the Cartesian grid.
+ * @param cartRank Pointer to the rank of the current process in the Cartesian communicator.
+ * @param coords Pointer to the coordinates of the current process in the Cartesian grid.
+ * @param discriminanteColore The color to determine the processes in the communicators.
+ */
+void createCommunicators(struct Communicators* comms, MPI_Comm parent, int* dims, int* periods, int* cartRank, int* coords, int discriminanteColore);
+
+/**
+ * @brief Finds the indices of the adjacent cells in a grid with wrap-around.
+ * 
+ * This function calculates the indices of the adjacent cells in a grid with wrap-around.
+ * The grid has dimensions (n/m)^2, and the distance between adjacent cells in the x and y directions is specified.
+ * The indices of the adjacent cells are stored in the AdjacentCells struct.
+ * The indices used to get cells position in matrix use a cartesian style indexing, not the usual row, col indexing.
+ * 
+ * @param index The index of the current cell.
+ * @param n The number of cells in the x direction.
+ * @param m The number of cells in the y direction.
+ * @param distX The distance between adjacent cells in the x direction.
+ * @param distY The distance between adjacent cells in the y direction.
+ * @param adj Pointer to the struct storing the indices of the adjacent cells.
+ */
+void findAdjacentCells(int index, int n, int m, int distX, int distY, AdjacentCells *adj);
+
+/**
+ * @brief Delivers to every process its aligned blocks of A and B in a single step.
+ * 
+ * Replaces the broadcasts and the initial alignment: every process receives straight from
+ * layer 0 the blocks it would hold after them.
+ * 
+ * @param localA Pointer to the block of A, replaced by the aligned one.
+ * @param localB Pointer to the block of B, replaced by the aligned one.
+ * @param count Number of elements of each block.
+ * @param q The side of each layer of the procs cube.
+ * @param m The depth of procs cube.
+ * @param engine The engine, which decides where the aligned blocks are.
+ * @param coords The Cartesian coordinates of the current process.
+ * @param commCart The Cartesian communicator.
+ */
+void fusedDistribution(elem_t** localA, elem_t** localB, int count, int q, int m, enum Engine engine, int* coords, MPI_Comm commCart);
+
+/**
+ * @brief Allocates the shared window of the shm engine and finds the slots on the node.
+ * 
+ * This is a collective operation over the grid.
+ * 
+ * @param ctx Pointer to the context, with its communicators already created.
+ */
+void createSharedBlocks(DnsContext* ctx);
+
+/**
+ * @brief Frees the shared window of the shm engine.
+ * 
+ * @param shared Pointer to the window to free.
+ */
+void freeSharedBlocks(SharedBlocks* shared);
+
+/**
+ * @brief Publishes the blocks of layer 0 in the shared window.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA Block of A, meaningful on layer 0 only.
+ * @param localB Block of B, meaningful on layer 0 only.
+ */
+void sharedDistribution(DnsContext* ctx, elem_t* localA, elem_t* localB);
+
+/**
+ * @brief Runs the steps of the layer on the published blocks and accumulates the partial product.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localC Block of C where the product is accumulated.
+ */
+void sharedMultiply(DnsContext* ctx, elem_t* localC);
+
+/**
+ * @brief Runs the Cannon steps of the layer with one-sided gets instead of the shifts.
+ * 
+ * @param ctx Pointer to the context.
+ * @param localA Block of A after the initial alignment, freed by the function.
+ * @param localB Block of B after the initial alignment, freed by the function.
+ * @param localC Block of C where the product is accumulated.
+ */
+void rmaMultiply(DnsContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC);
+
+/**
+ * @brief Sets up the persistent requests for the Cannon shifts.
+ * 
+ * The four buffers are allocated here and belong to the plan.
+ * 
+ * @param plan Pointer to the plan to initialize.
+ * @param count Number of elements of each block.
+ * @param adj Pointer to the adjacent cells at distance one.
+ * @param comm Communicator of the plane.
+ */
+void createShiftPlan(ShiftPlan* plan, int count, AdjacentCells* adj, MPI_Comm comm);
+
+/**
+ * @brief Frees the persistent requests and the buffers of a plan.
+ * 
+ * @param plan Pointer to the plan to free.
+ */
+void freeShiftPlan(ShiftPlan* plan);
+
+#endif // DNSENGINE_H
@@ -3,8 +3,28 @@
  * @brief This file contains the implementation of a DNS variant program.
  *
  * The program uses MPI (Message Passing Interface) to perform parallel computations on a 3D grid.
- * It creates different communicators to handle communication between processes in different dimensions.
- * The program also defines a struct to store information about adjacent cells in the grid.
+ * The grid, its communicators and the multiplication itself live in dnsEngine.c, this file
+ * reads the input matrices into layer 0 and delivers the result.
+ *
+ * The grid has q*q*m processes and every process owns a b*b block of each matrix, with
+ * b = ceil(n/q). The shape of the grid is chosen by the planner (or fixed with -q and -r) for
+ * any number of processes: when q does not divide n the matrices are padded with zeros, and
+ * the processes that do not fit in the grid stay idle. If the tuning file written by
+ * benchDns -a holds a configuration for this machine, n and p, its grid and kernel panels
+ * are used instead of the planner's choice.
+ *
+ * In batch mode (option -l) the grid is built once and reused for a list of products:
+ * the input of product k+1 is scattered and the result of product k-1 is gathered
+ * while product k is computed.
+ *
+ * With option -v every product is checked in the job itself with the Freivalds test
+ * (see productCheck.c), without gathering C and in O(n*n) work per process.
+ *
+ * In server mode (option -s) the grid stays up and computes the products requested
+ * through a Unix domain socket, one per line, until a client sends "quit".
+ *
+ * With -e summa the product runs instead on a rectangular 2D grid (see summaEngine.c),
+ * which uses almost every process for any p and accepts rectangular matrices.
  *
  * @author Cezar Narcis Culcea
  */
@@ -15,74 +35,227 @@
 #include <time.h>
 #include <math.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
 #include "inOutUtils.h"
+#include "mpiIOUtils.h"
+#include "gridPlanner.h"
+#include "dnsEngine.h"
+#include "serviceSocket.h"
+#include "phaseProfiler.h"
+#include "gemmKernel.h"
+#include "tuningCache.h"
+#include "productCheck.h"
+#include "summaEngine.h"
+#include "rankPlacement.h"
 
-#define X 2 /**< The X dimension index */
-#define Y 1 /**< The Y dimension index */
-#define Z 0 /**< The Z dimension index */
+#define FILENAME_LEN 256 /**< Maximum length of the file names in a batch list */
 
 /**
- * @struct Communicators
- * @brief Struct to store different MPI communicators.
- *
- * This struct stores different MPI communicators used for communication between processes in different dimensions.
+ * @enum InputMode
+ * @brief Ways of loading the input matrices into layer 0.
  */
-struct Communicators{
-    MPI_Comm commCart; /**< Communicator for X, Y, and Z dimensions */
-    MPI_Comm commXYplanes; /**< Communicator for horizontal planes */
-    MPI_Comm commYZplanes; /**< Communicator for vertical lateral planes */
-    MPI_Comm commZXplanes; /**< Communicator for front vertical planes */
-    MPI_Comm commXsingleDim; /**< Communicator for processes along X with fixed YZ */
-    MPI_Comm commYsingleDim; /**< Communicator for processes along Y with fixed XZ */
-    MPI_Comm commZsingleDim; /**< Communicator for processes along Z with fixed XY */
-    MPI_Comm commSubMatrixX; /**< Communicator for processes along X with equal rank modulo n/m */
-    MPI_Comm commSubMatrixY; /**< Communicator for processes along Y with equal rank modulo n/m */
+enum InputMode{
+    INPUT_ROOT, /**< Process 0 reads the whole matrices and scatters the blocks */
+    INPUT_MPIIO, /**< Each process of layer 0 reads its own blocks with MPI-IO */
+    INPUT_GENERATE /**< Each process of layer 0 generates its own blocks, without files */
 };
 
 /**
- * @struct AdjacentCells
- * @brief Struct to store information about adjacent cells.
- *
- * This struct stores the rank of the adjacent cells in the Cartesian communicator.
+ * @enum OutputMode
+ * @brief Ways of delivering the result matrix.
+ */
+enum OutputMode{
+    OUTPUT_GATHER, /**< Layer 0 gathers C on process 0, which writes the file */
+    OUTPUT_MPIIO, /**< Each process of layer 0 writes its own block with MPI-IO */
+    OUTPUT_REPLICATED, /**< C is not written, every layer keeps a copy of its blocks in memory */
+    OUTPUT_SCATTERED /**< Every layer keeps a slice of rows of each block and writes it with MPI-IO */
+};
+
+/**
+ * @struct InputTransfer
+ * @brief State of the loading of a pair of matrices into layer 0.
  */
 typedef struct {
-    int up; /**< Rank of the cell above (with wrap around) in the submatrices */
-    int down; /**< Rank of the cell below (with wrap around) in the submatrices */
-    int left; /**< Rank of the cell to the left (with wrap around) in the submatrices */
-    int right; /**< Rank of the cell to the right (with wrap around) in the submatrices */
-} AdjacentCells;
+    MappedMatrix mappedA; /**< File of A mapped by proc 0 */
+    MappedMatrix mappedB; /**< File of B mapped by proc 0 */
+    elem_t* matrixA; /**< Blocks of A ready to be scattered, on proc 0 */
+    elem_t* matrixB; /**< Blocks of B ready to be scattered, on proc 0 */
+    int zeroCopy; /**< The files are already split in blocks of side b */
+    int failed; /**< Proc 0 could not read the files and scatters zeros in their place */
+    MPI_Request requests[2]; /**< Scatters of A and B */
+} InputTransfer;
 
 /**
- * @brief Create different communicators for the program.
- *
- * This function creates different MPI communicators based on the given dimensions, periods, and ranks.
- * It also takes a discriminanteColore parameter to determine the color of the processes in the communicators.
- *
- * @param comms Pointer to the struct to store the created communicators.
- * @param dims Array of dimensions for the Cartesian grid.
- * @param periods Array of periods for the Cartesian grid.
- * @param cartRank Pointer to the rank of the current process in the Cartesian communicator.
- * @param coords Pointer to the coordinates of the current process in the Cartesian grid.
- * @param discriminanteColore The color to determine the processes in the communicators.
+ * @struct OutputTransfer
+ * @brief State of the delivery of a result matrix.
+ */
+typedef struct {
+    elem_t* finalC; /**< Reduced blocks of C owned by the process */
+    elem_t* matrixC; /**< Gathered blocks of C, on proc 0 */
+    MPI_Request request; /**< Gather of C */
+    char filename[FILENAME_LEN]; /**< File receiving C */
+} OutputTransfer;
+
+/**
+ * @struct BatchEntry
+ * @brief Files of one product of a batch.
+ */
+typedef struct {
+    char fileA[FILENAME_LEN]; /**< File of the first matrix */
+    char fileB[FILENAME_LEN]; /**< File of the second matrix */
+    char fileC[FILENAME_LEN]; /**< File receiving the product */
+} BatchEntry;
+
+/**
+ * @brief Starts loading a pair of matrices into layer 0.
+ * 
+ * With the root input the scatters are only started, and complete in finishInput.
+ * A read error is printed and returned, the caller decides whether to abort.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input Strategy used to read the matrices.
+ * @param fileA File of the first matrix.
+ * @param fileB File of the second matrix.
+ * @param localA Block of A receiving the data, of b*b elements.
+ * @param localB Block of B receiving the data, of b*b elements.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process read its part of the matrices, 1 otherwise.
+ */
+int startInput(DnsContext* ctx, enum InputMode input, char* fileA, char* fileB, elem_t* localA, elem_t* localB, InputTransfer* transfer);
+
+/**
+ * @brief Completes the loading started by startInput and releases its buffers.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input Strategy used to read the matrices.
+ * @param transfer Pointer to the state of the transfer.
+ */
+void finishInput(DnsContext* ctx, enum InputMode input, InputTransfer* transfer);
+
+/**
+ * @brief Sums the partial products of the layers as required by the output mode.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output Strategy used to deliver the result.
+ * @param localC Partial product of the layer, of ceil(b/m)*m*b elements.
+ * @return The reduced blocks owned by the process, NULL if it owns none.
+ */
+elem_t* reduceResult(DnsContext* ctx, enum OutputMode output, elem_t* localC);
+
+/**
+ * @brief Starts delivering a result matrix.
+ * 
+ * With the gather output the gather is only started, and completes in finishOutput.
+ * A write error is printed and returned, the caller decides whether to abort.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output Strategy used to deliver the result.
+ * @param fileC File receiving the result.
+ * @param finalC Reduced blocks returned by reduceResult, owned by the transfer from now on.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process wrote its part of the result, 1 otherwise.
  */
-void createCommunicators(struct Communicators* comms, int* dims, int* periods, int* cartRank, int* coords, int discriminanteColore);
+int startOutput(DnsContext* ctx, enum OutputMode output, char* fileC, elem_t* finalC, OutputTransfer* transfer);
 
 /**
- * @brief Finds the indices of the adjacent cells in a grid with wrap-around.
- * 
- * This function calculates the indices of the adjacent cells in a grid with wrap-around.
- * The grid has dimensions (n/m)^2, and the distance between adjacent cells in the x and y directions is specified.
- * The indices of the adjacent cells are stored in the AdjacentCells struct.
- * The indices used to get cells position in matrix use a cartesian style indexing, not the usual row, col indexing.
- * 
- * @param index The index of the current cell.
- * @param n The number of cells in the x direction.
- * @param m The number of cells in the y direction.
- * @param distX The distance between adjacent cells in the x direction.
- * @param distY The distance between adjacent cells in the y direction.
- * @param adj Pointer to the struct storing the indices of the adjacent cells.
+ * @brief Completes the delivery started by startOutput and releases its buffers.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output Strategy used to deliver the result.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process wrote its part of the result, 1 otherwise.
  */
-void findAdjacentCells(int index, int n, int m, int distX, int distY, AdjacentCells *adj);
+int finishOutput(DnsContext* ctx, enum OutputMode output, OutputTransfer* transfer);
+
+/**
+ * @brief Checks a result with the Freivalds test and reports the outcome on stderr.
+ * 
+ * This is a collective operation over the grid. With the scattered output the slices of C
+ * are first collected on layer 0.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output Strategy used to deliver the result.
+ * @param finalC Reduced blocks returned by reduceResult.
+ * @param blockA Block of A read by the process of layer 0, before the distribution.
+ * @param blockB Block of B read by the process of layer 0, before the distribution.
+ * @param fileC File receiving the result, used to name the product.
+ * @return 0 if the product passed the test, 1 otherwise.
+ */
+int checkResult(DnsContext* ctx, enum OutputMode output, elem_t* finalC, elem_t* blockA, elem_t* blockB, char* fileC);
+
+/**
+ * @brief Reads the list of products of a batch.
+ * 
+ * @param filename File with one product per line, as three file names: A, B and C.
+ * @param count Pointer to the number of products read.
+ * @param comm Communicator of the processes needing the list.
+ * @return The array of the products, or NULL if the list could not be read.
+ */
+BatchEntry* readBatchList(char* filename, int* count, MPI_Comm comm);
+
+/**
+ * @brief Computes a single product, from the input files to the delivered result.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input Strategy used to read the matrices.
+ * @param output Strategy used to deliver the result.
+ * @param entry Files of the product.
+ * @param time Pointer to the time spent by the calling process.
+ * @return 0 if the product was delivered, 1 if a file could not be read or written.
+ */
+int runProduct(DnsContext* ctx, enum InputMode input, enum OutputMode output, BatchEntry* entry, double* time);
+
+/**
+ * @brief Waits on proc 0 for the next valid request of the server mode.
+ * 
+ * Malformed requests and matrices whose size is not n are answered with an error
+ * and skipped, and so are the matrices failing their checksum if verify is set.
+ * 
+ * @param service Pointer to the socket of the server.
+ * @param n Size of the matrices handled by the grid.
+ * @param verify If not zero, the checksums of A and B are verified.
+ * @param entry Pointer to the files of the product, all empty to stop the server.
+ */
+void nextRequest(ServiceSocket* service, int n, int verify, BatchEntry* entry);
+
+/**
+ * @brief Verifies the checksum of the payload of a matrix file.
+ * 
+ * @param filename Name of the file.
+ * @param header Header of the file, already read.
+ * @return 0 if the checksum matches, 1 otherwise or if the file cannot be read.
+ */
+int verifyRequestFile(char* filename, MatrixFileHeader* header);
+
+/**
+ * @brief Serves the products requested through a Unix domain socket.
+ * 
+ * This is a collective operation over the grid; it returns when a client sends "quit".
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input Strategy used to read the matrices.
+ * @param output Strategy used to deliver the result.
+ * @param socketPath Path of the socket, opened by proc 0.
+ */
+void serveRequests(DnsContext* ctx, enum InputMode input, enum OutputMode output, char* socketPath);
+
+/**
+ * @brief Computes a single product with the SUMMA engine, from the input files to the result.
+ * 
+ * This is a collective operation over MPI_COMM_WORLD; the processes left out of the grid
+ * return immediately.
+ * 
+ * @param input Strategy used to read the matrices.
+ * @param output Strategy used to deliver the result, except OUTPUT_SCATTERED.
+ * @param n Size of the square matrices, or 0 to read the sizes from the headers.
+ * @param gridRows Requested rows of the grid, or 0 to choose them.
+ * @param gridCols Requested columns of the grid, or 0 to choose them.
+ * @param panel Maximum width of the panels.
+ * @param entry Files of the product.
+ * @param reportFile Report of the per-phase timers, or NULL.
+ */
+void runSumma(enum InputMode input, enum OutputMode output, int n, int gridRows, int gridCols, int panel, BatchEntry* entry, char* reportFile);
 
 /**
  * @brief The main function of the program.
@@ -95,246 +268,1083 @@ int main(int argc, char* argv[]){
     double total_time; /**< Timer total time */
     double input_time; /**< Timer input time */
     int myRank; /**< The rank of the current process */
-    int cartRank; /**< The rank of the current process in the Cartesian communicator */
-    int cartCoords[3]; /**< The Cartesian coordinates of the current process */
     int p; /**< The total number of processes */
     int n; /**< The dimension of the matrix */
-    int m; /**< The depth of procs cube */
+    int q = 0; /**< The side of each layer of the procs cube */
+    int m = 0; /**< The depth of procs cube */
+    int b; /**< The side of the block owned by each process */
+    int sliceRows; /**< Rows of each block of C owned by a layer in scattered output */
+    int opt; /**< Current command-line option */
+    int threadSupport; /**< Thread support level provided by MPI */
+    int gridRows = 0, gridCols = 0; /**< Shape of the grid of the SUMMA engine */
+    int panel = SUMMA_PANEL; /**< Width of the panels of the SUMMA engine */
+    enum Engine engine = ENGINE_CANNON; /**< Strategy used for the shifts */
+    enum InputMode input = INPUT_ROOT; /**< Strategy used to read the matrices */
+    enum OutputMode output = OUTPUT_GATHER; /**< Strategy used to deliver the result */
+    enum DistributionMode distribution = DISTRIBUTION_BCAST; /**< Strategy used to place the blocks */
+    GridPlan grid; /**< Shape of the process grid */
+    MPI_Comm commActive; /**< Processes taking part in the grid */
+    DnsContext ctx; /**< Process grid and its communicators */
+    char* batchFile = NULL; /**< List of products of the batch mode */
+    char* socketPath = NULL; /**< Socket of the server mode */
+    char* reportFile = NULL; /**< Report of the per-phase timers */
+    int verify = 0; /**< Whether every product is checked with the Freivalds test */
+    int placement = -1; /**< Placement of the grid requested with -p, -1 for the launch order without report */
+    MPI_Comm commGrid; /**< Processes of the grid in the order of their cells */
+    int failures = 0; /**< Products that failed the check */
+    elem_t* checkA = NULL, *checkB = NULL; /**< Copies of the input blocks kept for the check */
+    BatchEntry* batch; /**< Products to compute */
+    int batchSize = 1; /**< Number of products to compute */
+    BatchEntry single = {"matrixA.bin", "matrixB.bin", "matrixC_dnsVariant.bin"}; /**< The only product without batch mode */
 
-    int* matrixA, *matrixB, *matrixC = NULL; /**< Pointers to the matrices */
-    int localA, localB, localC = 0; /**< Local variables for each process */
+    elem_t* localA, *localB, *localC; /**< Local blocks for each process */
 
-    MPI_Init(&argc, &argv);
+    //Only the main thread calls MPI, the OpenMP threads live inside the local multiplications
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
     MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
     MPI_Comm_size(MPI_COMM_WORLD, &p);
+    if(threadSupport < MPI_THREAD_FUNNELED && !myRank){
+        printf("Abort... la libreria MPI non supporta MPI_THREAD_FUNNELED\n\n");
+        fflush(stdout);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     /************************** INPUT ************************************/
-    if(argc != 2 && !myRank){
-        printf("Abort... usage ./betterDns [n]\n\n");
+    while((opt = getopt(argc, argv, "q:r:e:g:w:i:o:d:l:s:t:vp:")) != -1){
+        switch(opt){
+            case 'q':
+                q = strtol(optarg, NULL, 10);
+                break;
+            case 'r':
+                m = strtol(optarg, NULL, 10);
+                if(m < 1) q = -1;
+                break;
+            case 'e':
+                if(!strcmp(optarg, "cannon")) engine = ENGINE_CANNON;
+                else if(!strcmp(optarg, "pipelined")) engine = ENGINE_PIPELINED;
+                else if(!strcmp(optarg, "25d")) engine = ENGINE_25D;
+                else if(!strcmp(optarg, "shm")) engine = ENGINE_SHM;
+                else if(!strcmp(optarg, "rma")) engine = ENGINE_RMA;
+                else if(!strcmp(optarg, "summa")) engine = ENGINE_SUMMA;
+                else q = -1;
+                break;
+            case 'g':
+                if(sscanf(optarg, "%dx%d", &gridRows, &gridCols) != 2 || gridRows < 1 || gridCols < 1) q = -1;
+                break;
+            case 'w':
+                panel = strtol(optarg, NULL, 10);
+                if(panel < 1) q = -1;
+                break;
+            case 'i':
+                if(!strcmp(optarg, "root")) input = INPUT_ROOT;
+                else if(!strcmp(optarg, "mpiio")) input = INPUT_MPIIO;
+                else if(!strcmp(optarg, "generate")) input = INPUT_GENERATE;
+                else q = -1;
+                break;
+            case 'o':
+                if(!strcmp(optarg, "gather")) output = OUTPUT_GATHER;
+                else if(!strcmp(optarg, "mpiio")) output = OUTPUT_MPIIO;
+                else if(!strcmp(optarg, "replicated")) output = OUTPUT_REPLICATED;
+                else if(!strcmp(optarg, "scattered")) output = OUTPUT_SCATTERED;
+                else q = -1;
+                break;
+            case 'd':
+                if(!strcmp(optarg, "bcast")) distribution = DISTRIBUTION_BCAST;
+                else if(!strcmp(optarg, "fused")) distribution = DISTRIBUTION_FUSED;
+                else q = -1;
+                break;
+            case 'l':
+                batchFile = optarg;
+                break;
+            case 's':
+                socketPath = optarg;
+                break;
+            case 't':
+                reportFile = optarg;
+                break;
+            case 'v':
+                verify = 1;
+                break;
+            case 'p':
+                if(!strcmp(optarg, "launch")) placement = PLACEMENT_LAUNCH;
+                else if(!strcmp(optarg, "topology")) placement = PLACEMENT_TOPOLOGY;
+                else q = -1;
+                break;
+            default:
+                q = -1;
+                break;
+        }
+    }
+
+    if((optind < argc - 1 || q < 0 || (socketPath != NULL && (batchFile != NULL || verify)) ||
+        (input == INPUT_GENERATE && (optind == argc || socketPath != NULL)) ||
+        (engine == ENGINE_SUMMA && (q || m || placement >= 0 || batchFile != NULL || socketPath != NULL || verify || output == OUTPUT_SCATTERED || distribution != DISTRIBUTION_BCAST)) ||
+        (engine != ENGINE_SUMMA && (gridRows || panel != SUMMA_PANEL)) ||
+        (engine == ENGINE_SHM && distribution != DISTRIBUTION_BCAST)) && !myRank){
+        printf("Abort... usage ./dnsVariant [[-q grid side] [-r layers] [-e cannon|pipelined|25d|shm|rma] | -e summa [-g rowsxcols] [-w panel width]] [-i root|mpiio|generate] [-o gather|mpiio|replicated|scattered] [-d bcast|fused] [-p launch|topology] [-l batch list [-v] | -s socket | -v] [-t report.json|report.csv] [n]\n\n");
         fflush(stdout);
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
     MPI_Barrier(MPI_COMM_WORLD); //Wait for proc 0 to check input parameters
 
-    n = strtol(argv[1],NULL, 10);
-    m = p/(n*n);
+    if(engine == ENGINE_SUMMA){
+        runSumma(input, output, optind < argc ? strtol(argv[optind], NULL, 10) : 0, gridRows, gridCols, panel, &single, reportFile);
+        MPI_Finalize();
+        return 0;
+    }
 
-    if((n%m) && !myRank){
-        printf("Abort... n non è divisibile per m\n\n");
-        fflush(stdout);
-        MPI_Abort(MPI_COMM_WORLD, 1);
+    batch = &single;
+    if(batchFile != NULL){
+        batch = readBatchList(batchFile, &batchSize, MPI_COMM_WORLD);
+        if(batch == NULL && !myRank){
+            printf("Abort... %s non contiene una lista di prodotti valida\n\n", batchFile);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if(optind == argc - 1){
+        n = strtol(argv[optind],NULL, 10);
+    }else{
+        //Without n on the command line the size comes from the header of the first A
+        MatrixFileHeader header;
+        if(!myRank){
+            if(readMatrixInfo(&header, batch[0].fileA) || header.rows != header.cols){
+                printf("Abort... %s is not a valid square matrix\n\n", batch[0].fileA);
+                fflush(stdout);
+                MPI_Abort(MPI_COMM_WORLD, 3);
+            }
+            n = header.rows;
+        }
+        MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+
+    //Without -q and -r the configuration found by the autotuner wins over the planner
+    if(!q && !m){
+        int tuned[6] = {0}; /**< Found flag, q, m and the three panel sizes */
+        if(!myRank){
+            TuningEntry entry;
+            char machine[TUNING_MACHINE_LEN];
+            tuningMachine(machine);
+            if(!lookupTuning(TUNING_FILE, machine, n, p, engine, distribution, &entry)){
+                tuned[0] = 1;
+                tuned[1] = entry.q;
+                tuned[2] = entry.m;
+                tuned[3] = entry.mc;
+                tuned[4] = entry.kc;
+                tuned[5] = entry.nc;
+                fprintf(stderr, "Configurazione da %s: griglia %dx%dx%d, pannelli %d %d %d\n", TUNING_FILE,
+                        entry.q, entry.q, entry.m, entry.mc, entry.kc, entry.nc);
+            }
+        }
+        MPI_Bcast(tuned, 6, MPI_INT, 0, MPI_COMM_WORLD);
+        if(tuned[0]){
+            q = tuned[1];
+            m = tuned[2];
+            gemmSetTiles(tuned[3], tuned[4], tuned[5]);
+        }
+    }
+
+    if(planGrid(n, p, q, m, &grid)){
+        if(!myRank){
+            printf("Abort... nessuna griglia q*q*m con m divisore di q e q*q*m <= p\n\n");
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    q = grid.q;
+    m = grid.m;
+    b = grid.b;
+
+    //The processes left out of the grid do not take part in the computation
+    MPI_Comm_split(MPI_COMM_WORLD, myRank < grid.active ? 0 : MPI_UNDEFINED, myRank, &commActive);
+    if(commActive == MPI_COMM_NULL){
+        if(batch != &single) free(batch);
+        MPI_Finalize();
+        return 0;
+    }
+    if(!myRank && grid.active < p){
+        fprintf(stderr, "Griglia %dx%dx%d: %d processi inattivi\n", q, q, m, p - grid.active);
+    }
+
+    //Room for m equal slices of rows, so that C can be reduce-scattered along Z
+    sliceRows = (b + m - 1) / m;
+    localA = malloc(b*b*sizeof(elem_t));
+    localB = malloc(b*b*sizeof(elem_t));
+    if(localA==NULL || localB==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
     }
 
     /* Start the timer */
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(commActive);
     total_time = -MPI_Wtime();
+
+    /****************************** COMUNICATORS ************************************/
+    commGrid = placeGrid(commActive, q, m, placement == PLACEMENT_TOPOLOGY ? PLACEMENT_TOPOLOGY : PLACEMENT_LAUNCH);
+    createDnsContext(&ctx, commGrid, n, q, m, engine, distribution);
+    if(placement >= 0){
+        //The report is not part of the measured time
+        double report_time = -MPI_Wtime();
+        reportPlacement(&ctx);
+        report_time += MPI_Wtime();
+        total_time -= report_time;
+    }
+
+    if(socketPath != NULL){
+        //The grid stays up and serves the products requested through the socket
+        free(localA);
+        free(localB);
+        serveRequests(&ctx, input, output, socketPath);
+        if(reportFile != NULL && writePhaseReport(commActive, reportFile) && !myRank){
+            printf("Error writing %s\n", reportFile);
+        }
+        freeDnsContext(&ctx);
+        MPI_Comm_free(&commGrid);
+        MPI_Comm_free(&commActive);
+        MPI_Finalize();
+        return 0;
+    }
+
     /****************************** INPUT ************************************/ 
+    InputTransfer inputTransfer; /**< Loading of the next pair of matrices */
+    OutputTransfer outputTransfer; /**< Delivery of the previous result */
+    if(startInput(&ctx, input, batch[0].fileA, batch[0].fileB, localA, localB, &inputTransfer)){
+        MPI_Abort(MPI_COMM_WORLD, 3);
+    }
+    finishInput(&ctx, input, &inputTransfer);
 
-    if(!myRank){
-        matrixA = malloc(n*n*sizeof(int));
-        matrixB = malloc(n*n*sizeof(int));
+    /* Start take input timer here, since the algorithm is supposed to start from this configuration */
+    MPI_Barrier(commActive);
+    input_time = total_time + MPI_Wtime();
+
+    for(int k = 0; k < batchSize; k++){
+        elem_t* nextA = NULL, *nextB = NULL; /**< Blocks of the following product */
+        if(k + 1 < batchSize){
+            //The following pair travels while this product is computed
+            nextA = malloc(b*b*sizeof(elem_t));
+            nextB = malloc(b*b*sizeof(elem_t));
+            if(nextA==NULL || nextB==NULL){
+                printf("Abort... error allocating memory.\n");
+                MPI_Abort(MPI_COMM_WORLD, 2);
+            }
+            if(startInput(&ctx, input, batch[k+1].fileA, batch[k+1].fileB, nextA, nextB, &inputTransfer)){
+                MPI_Abort(MPI_COMM_WORLD, 3);
+            }
+        }
+
+        if(verify && ctx.coords[Z] == 0){
+            //The distribution moves and releases the blocks read by layer 0
+            checkA = malloc(b*b*sizeof(elem_t));
+            checkB = malloc(b*b*sizeof(elem_t));
+            if(checkA==NULL || checkB==NULL){
+                printf("Abort... error allocating memory.\n");
+                MPI_Abort(MPI_COMM_WORLD, 2);
+            }
+            memcpy(checkA, localA, b*b*sizeof(elem_t));
+            memcpy(checkB, localB, b*b*sizeof(elem_t));
+        }
 
-        if(matrixA==NULL || matrixB==NULL){ //Check succesfull memory allocation
+        /****************************** DISTRIBUTION ************************************/
+        distributeBlocks(&ctx, &localA, &localB);
+
+        /****************************** COMPUTATION ************************************/
+        localC = calloc((size_t)sliceRows*m*b, sizeof(elem_t));
+        if(localC==NULL){
             printf("Abort... error allocating memory.\n");
             MPI_Abort(MPI_COMM_WORLD, 2);
-        }                
+        }
+        multiplyBlocks(&ctx, localA, localB, localC);
 
-        //Check successful reading
-        if(readMatrixFromFile(matrixA, n, "matrixA.bin") || readMatrixFromFile(matrixB, n, "matrixB.bin")){
-            printf("Error reading matrixA or matrixB\n");
-            fflush(stdout);
+        /****************************** REDUCE C LOCALE ************************************/
+        elem_t* finalC = reduceResult(&ctx, output, localC);
+        free(localC);
+
+        /****************************** VERIFICATION ************************************/
+        if(verify){
+            //The check is not part of the measured time
+            double check_time = -MPI_Wtime();
+            failures += checkResult(&ctx, output, finalC, checkA, checkB, batch[k].fileC);
+            check_time += MPI_Wtime();
+            total_time -= check_time;
+            free(checkA);
+            free(checkB);
+        }
+
+        /****************************** OUTPUT ************************************/
+        if(k > 0 && finishOutput(&ctx, output, &outputTransfer)){
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        if(batchSize == 1){
+            /* Stop the timer. Algorithm ends when layer 0 has the whole C matrix */
+            MPI_Barrier(commActive);
+            total_time += MPI_Wtime();
+        }
+        if(startOutput(&ctx, output, batch[k].fileC, finalC, &outputTransfer)){
             MPI_Abort(MPI_COMM_WORLD, 3);
         }
+
+        if(k + 1 < batchSize){
+            finishInput(&ctx, input, &inputTransfer);
+            localA = nextA;
+            localB = nextB;
+        }
+    }
+    if(finishOutput(&ctx, output, &outputTransfer)){
+        MPI_Abort(MPI_COMM_WORLD, 3);
     }
 
-    /****************************** COMUNICATORS ************************************/
-    struct Communicators* comms;
-    comms = malloc(sizeof(struct Communicators));
-
-    int num_dimensions = 3;
-    int dims[3] = {0, 0, 0};
-    dims[X] = n;
-    dims[Y] = n;
-    dims[Z] = m;
-    int periods[3] = {0, 0, 0};
-    
-    createCommunicators(comms, dims, periods, &cartRank, cartCoords, n/m);
-    
-    /****************************** SCATTER ************************************/
-    //Proc 0 distribute the matrices along n^2 procs in layer 0
-    if(cartCoords[Z] == 0){
-        MPI_Scatter(matrixA, 1, MPI_INT, &localA, 1, MPI_INT, 0, comms->commXYplanes); 
-        MPI_Scatter(matrixB, 1, MPI_INT, &localB, 1, MPI_INT, 0, comms->commXYplanes);
+    if(batchSize > 1){
+        //In batch mode the time covers every product, output included
+        MPI_Barrier(commActive);
+        total_time += MPI_Wtime();
     }
 
     if(!myRank){
-        free(matrixA);
-        free(matrixB);
+        printf("%10.6f\t%10.6f\n",input_time, total_time - input_time);
+    }
+    if(reportFile != NULL && writePhaseReport(commActive, reportFile) && !myRank){
+        printf("Error writing %s\n", reportFile);
     }
 
-    /* Start take input timer here, since the algorithm is supposed to start from this configuration */
-    MPI_Barrier(MPI_COMM_WORLD);
-    input_time = total_time + MPI_Wtime();
+    freeDnsContext(&ctx);
+    MPI_Comm_free(&commGrid);
+    if(batch != &single) free(batch);
+    MPI_Barrier(commActive);
+    MPI_Comm_free(&commActive);
+    MPI_Finalize();
+    
+    return failures != 0;
+}
 
-    /****************************** BCAST A Columns ************************************/
-    MPI_Bcast(&localA, 1, MPI_INT, 0, comms->commZsingleDim);
+/**
+ * @brief Starts loading a pair of matrices into layer 0.
+ * 
+ * With the root input proc 0 maps both files, reorders them so that every block is
+ * contiguous (unless they are already block-major with blocks of side b, in which case
+ * the mapped data is scattered as it is) and starts a nonblocking scatter of each matrix
+ * along layer 0. With the MPI-IO input every process of layer 0 reads its own blocks.
+ * With the generated input every process of layer 0 fills its own blocks with the same
+ * values generateMatrix would write in the files, and the file names are ignored.
+ * 
+ * If proc 0 cannot read the files it scatters zeros instead, so that layer 0 still
+ * completes the scatters and the grid can agree on the failure afterwards.
+ * 
+ * @param ctx The pointer to the context of the grid.
+ * @param input The strategy used to read the matrices.
+ * @param fileA The file of the first matrix.
+ * @param fileB The file of the second matrix.
+ * @param localA The block of A receiving the data.
+ * @param localB The block of B receiving the data.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process read its part of the matrices, 1 otherwise.
+ */
+int startInput(DnsContext* ctx, enum InputMode input, char* fileA, char* fileB, elem_t* localA, elem_t* localB, InputTransfer* transfer){
+    int n = ctx->n;
+    int q = ctx->q;
+    int b = ctx->b;
+    int* cartCoords = ctx->coords;
 
-    /****************************** BCAST B Rows ************************************/
-    MPI_Bcast(&localB, 1, MPI_INT, 0, comms->commZsingleDim);
+    transfer->matrixA = NULL;
+    transfer->matrixB = NULL;
+    transfer->zeroCopy = 0;
+    transfer->failed = 0;
+    transfer->requests[0] = MPI_REQUEST_NULL;
+    transfer->requests[1] = MPI_REQUEST_NULL;
 
-    /****************************** BCAST A values over their rows in each layer, if layer = col ************************************/
-    MPI_Bcast(&localA, 1, MPI_INT, cartCoords[Z], comms->commSubMatrixX);
+    double blockBytes = (double)b*b*sizeof(elem_t);
 
-    /******************************* BCAST B  values over their cols in each layer, if layer = row ************************************/
-    MPI_Bcast(&localB, 1, MPI_INT, cartCoords[Z], comms->commSubMatrixY);
+    if(!ctx->cartRank && input == INPUT_ROOT){
+        phaseBegin(PHASE_READ);
+        //Check successful reading
+        int failedA = mapMatrixFile(&transfer->mappedA, fileA, 1);
+        int failedB = mapMatrixFile(&transfer->mappedB, fileB, 1);
+        if(failedA || failedB || checkMatrixHeader(&transfer->mappedA.header, n, n) || checkMatrixHeader(&transfer->mappedB.header, n, n)){
+            printf("Error reading %s or %s\n", fileA, fileB);
+            fflush(stdout);
+            if(!failedA) unmapMatrixFile(&transfer->mappedA);
+            if(!failedB) unmapMatrixFile(&transfer->mappedB);
+            transfer->failed = 1;
+        }
 
-    /****************************** COMPUTATION ************************************/
-    AdjacentCells adj;
-    int planeRank;
-    MPI_Comm_rank(comms->commXYplanes, &planeRank);
-
-    //Initial alignment
-    int rigaSubMatrix = cartCoords[Y] % (n/m);
-    int colonnaSubMatrix = cartCoords[X] % (n/m);
-    findAdjacentCells(planeRank, n, m, rigaSubMatrix, colonnaSubMatrix, &adj);
-    MPI_Sendrecv_replace(&localA, 1, MPI_INT, adj.left, 0, adj.right, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
-    MPI_Sendrecv_replace(&localB, 1, MPI_INT, adj.up, 0, adj.down, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
-    
-    //Compute
-    for(int i=0; i<n/m; i++){
-        localC += localA * localB;        
-        findAdjacentCells(planeRank, n, m, 1, 1, &adj);
-        MPI_Sendrecv_replace(&localA, 1, MPI_INT, adj.right, 0, adj.left, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
-        MPI_Sendrecv_replace(&localB, 1, MPI_INT, adj.down, 0, adj.up, 0, comms->commXYplanes, MPI_STATUS_IGNORE);
+        MatrixFileHeader* headerA = &transfer->mappedA.header;
+        MatrixFileHeader* headerB = &transfer->mappedB.header;
+        transfer->zeroCopy = !transfer->failed && n%q == 0 && headerA->layout == LAYOUT_BLOCK_MAJOR && headerA->blockSize == (uint32_t)b &&
+                             headerB->layout == LAYOUT_BLOCK_MAJOR && headerB->blockSize == (uint32_t)b;
+        if(transfer->zeroCopy){
+            //The blocks are scattered straight from the mapped files
+            transfer->matrixA = transfer->mappedA.data;
+            transfer->matrixB = transfer->mappedB.data;
+        }else if(transfer->failed){
+            //Zeros keep the scatters going, the product is discarded
+            transfer->matrixA = calloc((size_t)q*q*b*b, sizeof(elem_t));
+            transfer->matrixB = calloc((size_t)q*q*b*b, sizeof(elem_t));
+        }else{
+            transfer->matrixA = malloc((size_t)q*q*b*b*sizeof(elem_t));
+            transfer->matrixB = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        }
+        if(transfer->matrixA==NULL || transfer->matrixB==NULL){ //Check succesfull memory allocation
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        if(!transfer->zeroCopy && !transfer->failed){
+            //Reorder the matrices so that every block is contiguous (and padded), ready to be scattered
+            mappedMatrixToBlocks(&transfer->mappedA, transfer->matrixA, n, q);
+            mappedMatrixToBlocks(&transfer->mappedB, transfer->matrixB, n, q);
+        }
+        phaseEnd(PHASE_READ, 2.0*n*n*sizeof(elem_t));
     }
-    
-    /****************************** REDUCE C LOCALE ************************************/
-    int finalC;
-    MPI_Reduce(&localC, &finalC, 1, MPI_INT, MPI_SUM, 0, comms->commZsingleDim);
 
+    /****************************** SCATTER ************************************/
+    //Proc 0 distribute the blocks of the matrices along q^2 procs in layer 0
+    if(cartCoords[Z] == 0 && input == INPUT_ROOT){
+        phaseBegin(PHASE_SCATTER);
+        MPI_Iscatter(transfer->matrixA, b*b, MPI_ELEM, localA, b*b, MPI_ELEM, 0, ctx->comms.commXYplanes, &transfer->requests[0]);
+        MPI_Iscatter(transfer->matrixB, b*b, MPI_ELEM, localB, b*b, MPI_ELEM, 0, ctx->comms.commXYplanes, &transfer->requests[1]);
+        phaseEnd(PHASE_SCATTER, 2*blockBytes);
+    }
 
-    /* Stop the timer. Algorithm ends when layer 0 has the whole C matrix */
-    MPI_Barrier(MPI_COMM_WORLD);
-    total_time += MPI_Wtime();
+    //Procs in layer 0 read their own blocks straight from the files
+    if(cartCoords[Z] == 0 && input == INPUT_MPIIO){
+        phaseBegin(PHASE_READ);
+        if(readBlockFromFile(localA, n, q, cartCoords[Y], cartCoords[X], fileA, ctx->comms.commXYplanes) ||
+           readBlockFromFile(localB, n, q, cartCoords[Y], cartCoords[X], fileB, ctx->comms.commXYplanes)){
+            printf("Error reading %s or %s\n", fileA, fileB);
+            fflush(stdout);
+            transfer->failed = 1;
+        }
+        phaseEnd(PHASE_READ, 2*blockBytes);
+    }
+
+    //Procs in layer 0 generate their own blocks, the padding stays zero
+    if(cartCoords[Z] == 0 && input == INPUT_GENERATE){
+        phaseBegin(PHASE_READ);
+        int row = cartCoords[Y]*b, col = cartCoords[X]*b;
+        int rows = n - row < b ? n - row : b;
+        int cols = n - col < b ? n - col : b;
+        if(n % q){
+            memset(localA, 0, b*b*sizeof(elem_t));
+            memset(localB, 0, b*b*sizeof(elem_t));
+        }
+        generateMatrixTile(MATRIX_A, row, col, rows, cols, localA, b);
+        generateMatrixTile(MATRIX_B, row, col, rows, cols, localB, b);
+        phaseEnd(PHASE_READ, 0);
+    }
+    return transfer->failed;
+}
+
+/**
+ * @brief Completes the loading started by startInput and releases its buffers.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input The strategy used to read the matrices.
+ * @param transfer Pointer to the state of the transfer.
+ */
+void finishInput(DnsContext* ctx, enum InputMode input, InputTransfer* transfer){
+    if(ctx->coords[Z] == 0 && input == INPUT_ROOT){
+        //The bytes of the scatter were added when it started
+        phaseBegin(PHASE_SCATTER);
+        MPI_Waitall(2, transfer->requests, MPI_STATUSES_IGNORE);
+        phaseEnd(PHASE_SCATTER, 0);
+    }
+
+    if(!ctx->cartRank && input == INPUT_ROOT){
+        if(!transfer->zeroCopy){
+            free(transfer->matrixA);
+            free(transfer->matrixB);
+        }
+        if(!transfer->failed){
+            unmapMatrixFile(&transfer->mappedA);
+            unmapMatrixFile(&transfer->mappedB);
+        }
+    }
+}
+
+/**
+ * @brief Sums the partial products of the layers as required by the output mode.
+ * 
+ * The replicated output leaves the complete blocks on every layer, the scattered output
+ * leaves to layer z rows z*ceil(b/m) ... (z+1)*ceil(b/m) - 1 of them, the other outputs
+ * collect them on layer 0.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output The strategy used to deliver the result.
+ * @param localC The partial product of the layer.
+ * @return The reduced blocks owned by the process, NULL if it owns none.
+ */
+elem_t* reduceResult(DnsContext* ctx, enum OutputMode output, elem_t* localC){
+    int b = ctx->b;
+    int sliceRows = (b + ctx->m - 1) / ctx->m;
+    MPI_Comm commZsingleDim = ctx->comms.commZsingleDim;
+    elem_t* finalC = NULL;
+
+    phaseBegin(PHASE_REDUCE);
+    if(output == OUTPUT_REPLICATED){
+        //Every layer keeps the complete blocks of C, ready for a following computation
+        finalC = malloc(b*b*sizeof(elem_t));
+        if(finalC == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        MPI_Allreduce(localC, finalC, b*b, MPI_ELEM, MPI_SUM, commZsingleDim);
+    }else if(output == OUTPUT_SCATTERED){
+        //Layer z ends up with rows z*sliceRows ... (z+1)*sliceRows - 1 of the blocks of C
+        finalC = malloc(sliceRows*b*sizeof(elem_t));
+        if(finalC == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        MPI_Reduce_scatter_block(localC, finalC, sliceRows*b, MPI_ELEM, MPI_SUM, commZsingleDim);
+    }else{
+        if(ctx->coords[Z] == 0){
+            finalC = malloc(b*b*sizeof(elem_t));
+            if(finalC == NULL){
+                printf("Abort... error allocating memory.\n");
+                MPI_Abort(MPI_COMM_WORLD, 2);
+            }
+        }
+        MPI_Reduce(localC, finalC, b*b, MPI_ELEM, MPI_SUM, 0, commZsingleDim);
+    }
+    phaseEnd(PHASE_REDUCE, (double)b*b*sizeof(elem_t));
+    return finalC;
+}
+
+/**
+ * @brief Starts delivering a result matrix.
+ * 
+ * The gather output starts a nonblocking gather of the blocks of layer 0 on proc 0,
+ * the MPI-IO outputs write the blocks (or the slices of every layer) collectively.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output The strategy used to deliver the result.
+ * @param fileC The file receiving the result.
+ * @param finalC The reduced blocks returned by reduceResult.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process wrote its part of the result, 1 otherwise.
+ */
+int startOutput(DnsContext* ctx, enum OutputMode output, char* fileC, elem_t* finalC, OutputTransfer* transfer){
+    int n = ctx->n;
+    int q = ctx->q;
+    int b = ctx->b;
+    int sliceRows = (b + ctx->m - 1) / ctx->m;
+    int* cartCoords = ctx->coords;
+    int failed = 0;
+
+    transfer->finalC = finalC;
+    transfer->matrixC = NULL;
+    transfer->request = MPI_REQUEST_NULL;
+    snprintf(transfer->filename, FILENAME_LEN, "%s", fileC);
 
     /****************************** GATHER C ************************************/
-    if(!myRank) matrixC = malloc(n*n*sizeof(int));
-    if(cartCoords[Z] == 0){
-        MPI_Gather(&finalC, 1, MPI_INT, matrixC, 1, MPI_INT, 0, comms->commXYplanes);
+    if(!ctx->cartRank && output == OUTPUT_GATHER){
+        transfer->matrixC = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        if(transfer->matrixC == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+    }
+    if(cartCoords[Z] == 0 && output == OUTPUT_GATHER){
+        phaseBegin(PHASE_GATHER);
+        MPI_Igather(finalC, b*b, MPI_ELEM, transfer->matrixC, b*b, MPI_ELEM, 0, ctx->comms.commXYplanes, &transfer->request);
+        phaseEnd(PHASE_GATHER, (double)b*b*sizeof(elem_t));
     }
 
-    /****************************** OUTPUT ************************************/
-    if(!myRank){
-        printf("%10.6f\t%10.6f\n",input_time, total_time - input_time);
-        if(writeMatrixToFile(matrixC, n, "matrixC_dnsVariant.bin")){
-            printf("Error writing matrixC\n");
+    if(cartCoords[Z] == 0 && output == OUTPUT_MPIIO){
+        phaseBegin(PHASE_WRITE);
+        if(writeBlockToFile(finalC, n, q, cartCoords[Y], cartCoords[X], fileC, ctx->comms.commXYplanes)){
+            printf("Error writing %s\n", fileC);
             fflush(stdout);
-            MPI_Abort(MPI_COMM_WORLD, 3);
+            failed = 1;
+        }
+        phaseEnd(PHASE_WRITE, (double)b*b*sizeof(elem_t));
+    }
+    //All the layers write their slices at the same time
+    if(output == OUTPUT_SCATTERED){
+        phaseBegin(PHASE_WRITE);
+        if(writeBlockRowsToFile(finalC, n, q, cartCoords[Y], cartCoords[X], cartCoords[Z]*sliceRows, sliceRows, fileC, ctx->comms.commCart)){
+            printf("Error writing %s\n", fileC);
+            fflush(stdout);
+            failed = 1;
+        }
+        phaseEnd(PHASE_WRITE, (double)sliceRows*b*sizeof(elem_t));
+    }
+    return failed;
+}
+
+/**
+ * @brief Completes the delivery started by startOutput and releases its buffers.
+ * 
+ * With the gather output proc 0 brings the gathered blocks back to row-major order
+ * and writes the file.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param output The strategy used to deliver the result.
+ * @param transfer Pointer to the state of the transfer.
+ * @return 0 if the process wrote its part of the result, 1 otherwise.
+ */
+int finishOutput(DnsContext* ctx, enum OutputMode output, OutputTransfer* transfer){
+    int n = ctx->n;
+    int q = ctx->q;
+    int b = ctx->b;
+    int failed = 0;
+
+    if(ctx->coords[Z] == 0 && output == OUTPUT_GATHER){
+        phaseBegin(PHASE_GATHER);
+        MPI_Wait(&transfer->request, MPI_STATUS_IGNORE);
+        phaseEnd(PHASE_GATHER, 0);
+    }
+    free(transfer->finalC);
+
+    if(!ctx->cartRank && output == OUTPUT_GATHER){
+        phaseBegin(PHASE_WRITE);
+        //Bring the gathered blocks back to row-major order
+        elem_t* matrixC = transfer->matrixC;
+        elem_t* blocks = malloc((size_t)q*q*b*b*sizeof(elem_t));
+        if(blocks == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        memcpy(blocks, matrixC, (size_t)q*q*b*b*sizeof(elem_t));
+        blocksToMatrix(blocks, matrixC, n, q);
+        free(blocks);
+        if(writeMatrixToFile(matrixC, n, transfer->filename)){
+            printf("Error writing %s\n", transfer->filename);
+            fflush(stdout);
+            failed = 1;
         }
-        //printMatrix(matrixC, n);
         free(matrixC);
+        phaseEnd(PHASE_WRITE, (double)n*n*sizeof(elem_t));
     }
+    return failed;
+}
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    MPI_Finalize();
-    
-    return 0;
+/**
+ * @brief Checks a result with the Freivalds test and reports the outcome on stderr.
+ * 
+ * The replicated, gather and MPI-IO outputs already leave the complete blocks of C on
+ * layer 0; the scattered output leaves a slice on every layer, so the slices are gathered
+ * along Z first. Only layer 0 runs the test, and proc 0 prints the outcome.
+ * 
+ * @param ctx The pointer to the context of the grid.
+ * @param output The strategy used to deliver the result.
+ * @param finalC The reduced blocks returned by reduceResult.
+ * @param blockA The block of A read by the process of layer 0.
+ * @param blockB The block of B read by the process of layer 0.
+ * @param fileC The file receiving the result.
+ * @return 0 if the product passed the test, 1 otherwise.
+ */
+int checkResult(DnsContext* ctx, enum OutputMode output, elem_t* finalC, elem_t* blockA, elem_t* blockB, char* fileC){
+    int b = ctx->b;
+    int sliceRows = (b + ctx->m - 1) / ctx->m;
+    int failed = 0;
+    double residual = 0;
+    elem_t* blockC = finalC;
+
+    if(output == OUTPUT_SCATTERED){
+        blockC = NULL;
+        if(ctx->coords[Z] == 0) blockC = malloc((size_t)sliceRows*ctx->m*b*sizeof(elem_t));
+        MPI_Gather(finalC, sliceRows*b, MPI_ELEM, blockC, sliceRows*b, MPI_ELEM, 0, ctx->comms.commZsingleDim);
+    }
+
+    if(ctx->coords[Z] == 0){
+        failed = verifyProduct(ctx, blockA, blockB, blockC, &residual);
+        if(!ctx->cartRank){
+            fprintf(stderr, "Verifica di %s: %s (residuo %g)\n", fileC, failed ? "FALLITA" : "superata", residual);
+        }
+    }
+    if(blockC != finalC) free(blockC);
+
+    //Every process learns the outcome, layer 0 has it already
+    MPI_Bcast(&failed, 1, MPI_INT, 0, ctx->comms.commZsingleDim);
+    return failed;
+}
+
+/**
+ * @brief Reads the list of products of a batch.
+ * 
+ * Proc 0 reads the file and broadcasts the list, so that only proc 0 needs to see it.
+ * Every line holds the names of A, B and C separated by blanks.
+ * 
+ * @param filename The file with the list.
+ * @param count Pointer to the number of products read.
+ * @param comm The communicator of the processes needing the list.
+ * @return The array of the products, or NULL if the list could not be read or is empty.
+ */
+BatchEntry* readBatchList(char* filename, int* count, MPI_Comm comm){
+    int rank;
+    int capacity = 16;
+    BatchEntry* entries = NULL;
+
+    MPI_Comm_rank(comm, &rank);
+    *count = 0;
+    if(!rank){
+        FILE* file = fopen(filename, "r");
+        entries = malloc(capacity * sizeof(BatchEntry));
+        if(entries == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+        if(file != NULL){
+            BatchEntry entry;
+            while(fscanf(file, "%255s %255s %255s", entry.fileA, entry.fileB, entry.fileC) == 3){
+                if(*count == capacity){
+                    BatchEntry* grown = realloc(entries, 2 * capacity * sizeof(BatchEntry));
+                    if(grown == NULL){
+                        free(entries);
+                        fclose(file);
+                        printf("Abort... error allocating memory.\n");
+                        MPI_Abort(MPI_COMM_WORLD, 2);
+                    }
+                    entries = grown;
+                    capacity *= 2;
+                }
+                entries[(*count)++] = entry;
+            }
+            fclose(file);
+        }
+    }
+
+    MPI_Bcast(count, 1, MPI_INT, 0, comm);
+    if(*count == 0){
+        free(entries);
+        return NULL;
+    }
+    if(rank){
+        entries = malloc(*count * sizeof(BatchEntry));
+        if(entries == NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+    }
+    MPI_Bcast(entries, *count * sizeof(BatchEntry), MPI_BYTE, 0, comm);
+    return entries;
+}
+
+/**
+ * @brief Computes a single product, from the input files to the delivered result.
+ * 
+ * Unlike the batch mode nothing is overlapped, every phase completes before the next one.
+ * The read and write errors of the single processes are agreed on by the whole grid
+ * after the input and after the output, so a bad file makes every process give up the
+ * product together instead of aborting the grid.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input The strategy used to read the matrices.
+ * @param output The strategy used to deliver the result.
+ * @param entry The files of the product.
+ * @param time Pointer to the time spent by the calling process.
+ * @return 0 if the product was delivered, 1 if a file could not be read or written.
+ */
+int runProduct(DnsContext* ctx, enum InputMode input, enum OutputMode output, BatchEntry* entry, double* time){
+    InputTransfer inputTransfer;
+    OutputTransfer outputTransfer;
+    int b = ctx->b;
+    int sliceRows = (b + ctx->m - 1) / ctx->m;
+    int failed;
+    *time = -MPI_Wtime();
+
+    elem_t* localA = malloc(b*b*sizeof(elem_t));
+    elem_t* localB = malloc(b*b*sizeof(elem_t));
+    elem_t* localC = calloc((size_t)sliceRows*ctx->m*b, sizeof(elem_t));
+    if(localA==NULL || localB==NULL || localC==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    failed = startInput(ctx, input, entry->fileA, entry->fileB, localA, localB, &inputTransfer);
+    finishInput(ctx, input, &inputTransfer);
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, ctx->comms.commCart);
+    if(failed){
+        free(localA);
+        free(localB);
+        free(localC);
+    }else{
+        distributeBlocks(ctx, &localA, &localB);
+        multiplyBlocks(ctx, localA, localB, localC);
+        elem_t* finalC = reduceResult(ctx, output, localC);
+        free(localC);
+        failed = startOutput(ctx, output, entry->fileC, finalC, &outputTransfer);
+        failed |= finishOutput(ctx, output, &outputTransfer);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, ctx->comms.commCart);
+    }
+
+    *time += MPI_Wtime();
+    return failed;
 }
+
+/**
+ * @brief Waits on proc 0 for the next valid request of the server mode.
+ * 
+ * A request is a line with the names of A, B and C; "quit" stops the server, and so does
+ * a failure of the socket. Only the headers are checked here; the files that turn out
+ * unreadable or unwritable later make runProduct fail on the whole grid, which answers
+ * with "ERR" and goes on serving.
+ * 
+ * With the MPI-IO input no process reads the whole payload, so the checksums are verified
+ * here by proc 0, before the request reaches the grid.
+ * 
+ * @param service Pointer to the socket of the server.
+ * @param n The size of the matrices handled by the grid.
+ * @param verify If not zero, the checksums of A and B are verified.
+ * @param entry Pointer to the files of the product, all empty to stop the server.
+ */
+void nextRequest(ServiceSocket* service, int n, int verify, BatchEntry* entry){
+    char line[3*FILENAME_LEN + 16];
+    BatchEntry request; /**< Files of the request being checked, copied to entry once accepted */
+    MatrixFileHeader headerA, headerB;
+    int status;
+
+    memset(entry, 0, sizeof(BatchEntry));
+    while((status = readServiceRequest(service, line, sizeof(line))) != 1){
+        if(status == 2){
+            sendServiceReply(service, "ERR richiesta troppo lunga");
+            continue;
+        }
+        if(!strcmp(line, "quit")) return;
+        if(line[0] == '\0') continue;
+
+        if(sscanf(line, "%255s %255s %255s", request.fileA, request.fileB, request.fileC) != 3){
+            sendServiceReply(service, "ERR richiesta non valida, attesi i file di A, B e C");
+        }else if(readMatrixInfo(&headerA, request.fileA) || readMatrixInfo(&headerB, request.fileB) ||
+                 checkMatrixHeader(&headerA, n, n) || checkMatrixHeader(&headerB, n, n)){
+            sendServiceReply(service, "ERR matrici non leggibili o di dimensione diversa da quella della griglia");
+        }else if(verify && (verifyRequestFile(request.fileA, &headerA) || verifyRequestFile(request.fileB, &headerB))){
+            sendServiceReply(service, "ERR checksum delle matrici non valido");
+        }else{
+            *entry = request;
+            return;
+        }
+    }
+}
+
 /**
- * @brief Creates communicators for the given dimensions and periods.
- * 
- * This function creates communicators for a Cartesian topology with the specified dimensions and periods.
- * It also creates sub-communicators for different planes and single dimensions.
- * Additionally, it splits the communicator based on the coordinates and a discriminant color.
- * 
- * @param comms Pointer to the struct containing the communicators.
- * @param dims Array of dimensions for the Cartesian topology.
- * @param periods Array of periods for the Cartesian topology.
- * @param cartRank Pointer to the variable storing the rank in the Cartesian communicator.
- * @param coords Pointer to the array storing the coordinates in the Cartesian communicator.
- * @param discriminanteColore The discriminant color used for splitting the communicator in submatrices.
+ * @brief Verifies the checksum of the payload of a matrix file.
+ * 
+ * @param filename The name of the file.
+ * @param header The header of the file, already read.
+ * @return 0 if the checksum matches, 1 otherwise or if the file cannot be read.
  */
-void createCommunicators(struct Communicators* comms, int* dims, int* periods, int* cartRank, int* coords, int discriminanteColore){
-    MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 0, &comms->commCart);
-    MPI_Comm_rank(comms->commCart, cartRank);
-    MPI_Cart_coords(comms->commCart, *cartRank, 3, coords);
-    int remaining_dims[3] = {0, 0, 0};
-
-    remaining_dims[X] = 1;
-    remaining_dims[Y] = 1;
-    remaining_dims[Z] = 0;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commXYplanes);
-
-    remaining_dims[X] = 0;
-    remaining_dims[Y] = 1;
-    remaining_dims[Z] = 1;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commYZplanes);
-
-    remaining_dims[X] = 1;
-    remaining_dims[Y] = 0;
-    remaining_dims[Z] = 1;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commZXplanes);
-
-    remaining_dims[X] = 1;
-    remaining_dims[Y] = 0;
-    remaining_dims[Z] = 0;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commXsingleDim);
-
-    remaining_dims[X] = 0;
-    remaining_dims[Y] = 1;
-    remaining_dims[Z] = 0;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commYsingleDim);
-
-    remaining_dims[X] = 0;
-    remaining_dims[Y] = 0;
-    remaining_dims[Z] = 1;
-    MPI_Cart_sub(comms->commCart, remaining_dims, &comms->commZsingleDim);
-    //These communicators include all the processes in the same row, that have the same rank inside all'submatrices
-    int color = coords[X] % discriminanteColore;
-    MPI_Comm_split(comms->commXsingleDim, color, *cartRank, &comms->commSubMatrixX);
-    //These communicators include all the processes in the same col, that have the same rank inside all'submatrices
-    color = coords[Y] % discriminanteColore;
-    MPI_Comm_split(comms->commYsingleDim, color, *cartRank, &comms->commSubMatrixY);
+int verifyRequestFile(char* filename, MatrixFileHeader* header){
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) return 1;
+    int failed = verifyMatrixFile(fd, header);
+    close(fd);
+    return failed;
+}
+
+/**
+ * @brief Serves the products requested through a Unix domain socket.
+ * 
+ * Proc 0 owns the socket: it waits for a request, broadcasts the file names to the grid,
+ * and once the product is done answers with "OK" followed by the time it took, or with
+ * "ERR" if a file could not be read or written.
+ * 
+ * @param ctx Pointer to the context of the grid.
+ * @param input The strategy used to read the matrices.
+ * @param output The strategy used to deliver the result.
+ * @param socketPath The path of the socket, opened by proc 0.
+ */
+void serveRequests(DnsContext* ctx, enum InputMode input, enum OutputMode output, char* socketPath){
+    ServiceSocket service;
+    BatchEntry entry;
+    char reply[64];
+
+    if(!ctx->cartRank){
+        if(openServiceSocket(&service, socketPath)){
+            printf("Error opening %s\n", socketPath);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        fprintf(stderr, "In ascolto su %s\n", socketPath);
+    }
+
+    while(1){
+        if(!ctx->cartRank) nextRequest(&service, ctx->n, input == INPUT_MPIIO, &entry);
+        MPI_Bcast(&entry, sizeof(BatchEntry), MPI_BYTE, 0, ctx->comms.commCart);
+        if(entry.fileA[0] == '\0') break;
+
+        double time;
+        int failed = runProduct(ctx, input, output, &entry, &time);
+        if(!ctx->cartRank && failed){
+            sendServiceReply(&service, "ERR lettura o scrittura dei file non riuscita");
+        }else if(!ctx->cartRank){
+            snprintf(reply, sizeof(reply), "OK %.6f", time);
+            sendServiceReply(&service, reply);
+        }
+    }
+
+    if(!ctx->cartRank){
+        sendServiceReply(&service, "BYE");
+        closeServiceSocket(&service);
+    }
 }
 
 /**
- * @brief Finds the indices of the adjacent cells in a grid with wrap-around.
- * 
- * This function calculates the indices of the adjacent cells in a grid with wrap-around.
- * The grid has dimensions (n/m)^2, and the distance between adjacent cells in the x and y directions is specified.
- * The indices of the adjacent cells are stored in the AdjacentCells struct.
- * The indices used to get cells position in matrix use a cartesian style indexing, not the usual row, col indexing.
- * 
- * @param index The index of the current cell.
- * @param n The number of cells in the x direction.
- * @param m The number of cells in the y direction.
- * @param distX The distance between adjacent cells in the x direction.
- * @param distY The distance between adjacent cells in the y direction.
- * @param adj Pointer to the struct storing the indices of the adjacent cells.
+ * @brief Computes a single product with the SUMMA engine, from the input files to the result.
+ * 
+ * Proc 0 reads the sizes from the headers of the files and the planner chooses a grid
+ * for them. Every process then reads (or generates) the part of its tiles that lies inside
+ * the matrices, so the padding stays zero, and after the multiplication writes its tile of
+ * C straight into the file. The checksums of the tiles are summed on proc 0, which writes
+ * the header last. The gather and MPI-IO outputs both write in this way.
+ * 
+ * @param input The strategy used to read the matrices.
+ * @param output The strategy used to deliver the result.
+ * @param n The size of the square matrices, or 0 to read the sizes from the headers.
+ * @param gridRows The requested rows of the grid, or 0 to choose them.
+ * @param gridCols The requested columns of the grid, or 0 to choose them.
+ * @param panel The maximum width of the panels.
+ * @param entry The files of the product.
+ * @param reportFile The report of the per-phase timers, or NULL.
  */
-void findAdjacentCells(int index, int n, int m, int distX, int distY, AdjacentCells *adj) {
-    int sm_size = n / m;  // submatrix size
-    int x = index % n;    // coord x cell
-    int y = index / n;    // coord y cell
-
-    // Get offset due to submatrix
-    int sub_x = x / sm_size * sm_size;
-    int sub_y = y / sm_size * sm_size;
-
-    // Get adjacent cells coordinate in submatrix with wrap around
-    int up_x = x;
-    int up_y = (y - distY + sm_size) % sm_size + sub_y;
-    adj->up = up_y * n + up_x;
-
-    int down_x = x;
-    int down_y = (y + distY) % sm_size + sub_y;
-    adj->down = down_y * n + down_x;
-
-    int left_x = (x - distX + sm_size) % sm_size + sub_x;
-    int left_y = y;
-    adj->left = left_y * n + left_x;
-
-    int right_x = (x + distX) % sm_size + sub_x;
-    int right_y = y;
-    adj->right = right_y * n + right_x;
+void runSumma(enum InputMode input, enum OutputMode output, int n, int gridRows, int gridCols, int panel, BatchEntry* entry, char* reportFile){
+    double total_time; /**< Timer total time */
+    double input_time; /**< Timer input time */
+    int myRank; /**< The rank of the current process */
+    int p; /**< The total number of processes */
+    int sizes[3] = {n, n, n}; /**< Rows, inner dimension and columns of the product */
+    SummaPlan grid; /**< Shape of the process grid */
+    MPI_Comm commActive; /**< Processes taking part in the grid */
+    SummaContext ctx; /**< Process grid and its communicators */
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    if(!myRank && input != INPUT_GENERATE){
+        MatrixFileHeader headerA, headerB;
+        if(readMatrixInfo(&headerA, entry->fileA) || readMatrixInfo(&headerB, entry->fileB) || headerB.rows != headerA.cols ||
+           (n && (headerA.rows != (uint64_t)n || headerA.cols != (uint64_t)n || headerB.cols != (uint64_t)n))){
+            printf("Abort... %s and %s are not valid compatible matrices\n\n", entry->fileA, entry->fileB);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        sizes[0] = headerA.rows;
+        sizes[1] = headerA.cols;
+        sizes[2] = headerB.cols;
+    }
+    MPI_Bcast(sizes, 3, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if(planSummaGrid(sizes[0], sizes[1], sizes[2], p, gridRows, gridCols, &grid)){
+        if(!myRank){
+            printf("Abort... nessuna griglia righe*colonne con righe*colonne <= p\n\n");
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    //The processes left out of the grid do not take part in the computation
+    MPI_Comm_split(MPI_COMM_WORLD, myRank < grid.active ? 0 : MPI_UNDEFINED, myRank, &commActive);
+    if(commActive == MPI_COMM_NULL) return;
+    if(!myRank && grid.active < p){
+        fprintf(stderr, "Griglia %dx%d: %d processi inattivi\n", grid.gridRows, grid.gridCols, p - grid.active);
+    }
+
+    /* Start the timer */
+    MPI_Barrier(commActive);
+    total_time = -MPI_Wtime();
+
+    /****************************** COMUNICATORS ************************************/
+    createSummaContext(&ctx, commActive, sizes[0], sizes[1], sizes[2], grid.gridRows, grid.gridCols, panel);
+
+    elem_t* localA = calloc((size_t)ctx.tileRows*ctx.tileInnerA, sizeof(elem_t));
+    elem_t* localB = calloc((size_t)ctx.tileInnerB*ctx.tileCols, sizeof(elem_t));
+    elem_t* localC = calloc((size_t)ctx.tileRows*ctx.tileCols, sizeof(elem_t));
+    if(localA==NULL || localB==NULL || localC==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    //Part of each tile inside the matrices, the rest is padding
+    int rowA = ctx.row*ctx.tileRows, colA = ctx.col*ctx.tileInnerA;
+    int rowB = ctx.row*ctx.tileInnerB, colB = ctx.col*ctx.tileCols;
+    int rowsA = sizes[0] - rowA < ctx.tileRows ? sizes[0] - rowA : ctx.tileRows;
+    int colsA = sizes[1] - colA < ctx.tileInnerA ? sizes[1] - colA : ctx.tileInnerA;
+    int rowsB = sizes[1] - rowB < ctx.tileInnerB ? sizes[1] - rowB : ctx.tileInnerB;
+    int colsB = sizes[2] - colB < ctx.tileCols ? sizes[2] - colB : ctx.tileCols;
+    if(colsA < 0) colsA = 0;
+    if(rowsB < 0) rowsB = 0;
+
+    /****************************** INPUT ************************************/
+    phaseBegin(PHASE_READ);
+    if(input == INPUT_GENERATE){
+        generateMatrixTile(MATRIX_A, rowA, colA, rowsA, colsA, localA, ctx.tileInnerA);
+        generateMatrixTile(MATRIX_B, rowB, colB, rowsB, colsB, localB, ctx.tileCols);
+    }else{
+        //Every process reads its own tiles, in any layout of the files
+        MatrixFileHeader headerA, headerB;
+        int fdA = open(entry->fileA, O_RDONLY);
+        int fdB = open(entry->fileB, O_RDONLY);
+        if(fdA < 0 || fdB < 0 || pread(fdA, &headerA, sizeof(headerA), 0) != sizeof(headerA) ||
+           pread(fdB, &headerB, sizeof(headerB), 0) != sizeof(headerB) ||
+           (colsA > 0 && readMatrixTile(fdA, &headerA, rowA, colA, rowsA, colsA, localA, ctx.tileInnerA)) ||
+           (rowsB > 0 && readMatrixTile(fdB, &headerB, rowB, colB, rowsB, colsB, localB, ctx.tileCols))){
+            printf("Error reading %s or %s\n", entry->fileA, entry->fileB);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        close(fdA);
+        close(fdB);
+    }
+    phaseEnd(PHASE_READ, ((double)rowsA*colsA + (double)rowsB*colsB)*sizeof(elem_t));
+
+    /* Start take input timer here, since the algorithm is supposed to start from this configuration */
+    MPI_Barrier(commActive);
+    input_time = total_time + MPI_Wtime();
+
+    /****************************** COMPUTATION ************************************/
+    summaMultiply(&ctx, localA, localB, localC);
+    free(localA);
+    free(localB);
+
+    /****************************** OUTPUT ************************************/
+    if(output != OUTPUT_REPLICATED){
+        MatrixFileHeader headerC;
+        uint64_t checksum = 0, total = 0;
+        int failed = 0;
+        int rowsC = sizes[0] - rowA < ctx.tileRows ? sizes[0] - rowA : ctx.tileRows;
+
+        phaseBegin(PHASE_WRITE);
+        initMatrixHeader(&headerC, sizes[0], sizes[2], LAYOUT_ROW_MAJOR, 0);
+        if(!myRank){
+            //Proc 0 creates the file at its final size before the others open it
+            int fd = open(entry->fileC, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            failed = fd < 0 || ftruncate(fd, sizeof(MatrixFileHeader) + (size_t)sizes[0]*sizes[2]*sizeof(elem_t));
+            if(fd >= 0) close(fd);
+        }
+        MPI_Bcast(&failed, 1, MPI_INT, 0, commActive);
+
+        int fdC = failed ? -1 : open(entry->fileC, O_WRONLY);
+        failed = fdC < 0 || writeMatrixTile(fdC, &headerC, rowA, colB, rowsC, colsB, localC, ctx.tileCols, &checksum);
+        MPI_Reduce(&checksum, &total, 1, MPI_UINT64_T, MPI_SUM, 0, commActive);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, commActive);
+        if(!myRank && !failed){
+            headerC.checksum = total;
+            failed = pwrite(fdC, &headerC, sizeof(MatrixFileHeader), 0) != sizeof(MatrixFileHeader);
+        }
+        if(fdC >= 0) close(fdC);
+        if(failed){
+            printf("Error writing %s\n", entry->fileC);
+            fflush(stdout);
+            MPI_Abort(MPI_COMM_WORLD, 3);
+        }
+        phaseEnd(PHASE_WRITE, (double)rowsC*colsB*sizeof(elem_t));
+    }
+    free(localC);
+
+    /* Stop the timer. Algorithm ends when C is delivered */
+    MPI_Barrier(commActive);
+    total_time += MPI_Wtime();
+
+    if(!myRank){
+        printf("%10.6f\t%10.6f\n",input_time, total_time - input_time);
+    }
+    if(reportFile != NULL && writePhaseReport(commActive, reportFile) && !myRank){
+        printf("Error writing %s\n", reportFile);
+    }
+
+    freeSummaContext(&ctx);
+    MPI_Comm_free(&commActive);
 }
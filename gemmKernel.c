@@ -0,0 +1,286 @@
+/**
+ * @file gemmKernel.c
+ * @brief This file contains a cache blocked and vectorized matrix multiplication kernel.
+ *
+ * The kernel follows the usual layered scheme: B is packed in panels of kc*nc elements,
+ * A in panels of mc*kc elements, and a micro-kernel keeps a GEMM_MR*GEMM_NR block of C
+ * in registers while it walks the packed panels contiguously. The panel sizes start from
+ * GEMM_MC, GEMM_KC and GEMM_NC and can be changed at runtime, e.g. by the autotuner.
+ * The compute function is cloned for AVX-512, AVX2 and generic x86-64, and the best clone
+ * is picked at runtime by the loader. Each element type gets its own clones, with the
+ * register block sized in gemmKernel.h.
+ *
+ * When compiled with OpenMP, large products are split among the threads: the panels are
+ * packed together and every thread computes its own micro-panels of B, so the packed
+ * buffers stay shared and the threads meet once per panel of A.
+ */
+
+#include "gemmKernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @def GEMM_SMALL
+ * @brief Below this number of multiply-adds the packing is not worth it.
+ */
+#define GEMM_SMALL (GEMM_MR*GEMM_NR*GEMM_MR)
+
+/**
+ * @def GEMM_PARALLEL
+ * @brief Below this number of multiply-adds a single thread is used.
+ */
+#define GEMM_PARALLEL (GEMM_MC*GEMM_KC*GEMM_NR*4L)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define GEMM_CLONES
+#endif
+
+static elem_t* packedA = NULL; /**< Buffer for the packed panel of A */
+static elem_t* packedB = NULL; /**< Buffer for the packed panel of B */
+static size_t packedASize = 0; /**< Capacity of packedA in elements */
+static size_t packedBSize = 0; /**< Capacity of packedB in elements */
+static int tileMC = GEMM_MC; /**< Rows of the panel of A */
+static int tileKC = GEMM_KC; /**< Depth of the panels */
+static int tileNC = GEMM_NC; /**< Columns of the panel of B */
+
+/**
+ * @brief Packs a panel of A in micro-panels of GEMM_MR rows.
+ * 
+ * Every micro-panel stores, for each k, the GEMM_MR elements of a column next to each other.
+ * Missing rows of the last micro-panel are padded with zeros.
+ * Inside a parallel region the micro-panels are shared among the threads.
+ * 
+ * @param matrixA Pointer to the top left element of the panel.
+ * @param lda Leading dimension of A.
+ * @param mc Rows of the panel.
+ * @param kc Columns of the panel.
+ * @param packed Pointer to the output buffer.
+ */
+static void packPanelA(const elem_t* matrixA, int lda, int mc, int kc, elem_t* packed){
+    #pragma omp for schedule(static)
+    for(int i = 0; i < mc; i += GEMM_MR){
+        int mr = mc - i < GEMM_MR ? mc - i : GEMM_MR;
+        elem_t* panel = packed + i*kc;
+        for(int k = 0; k < kc; k++){
+            for(int r = 0; r < mr; r++) panel[r] = matrixA[(i+r)*lda + k];
+            for(int r = mr; r < GEMM_MR; r++) panel[r] = 0;
+            panel += GEMM_MR;
+        }
+    }
+}
+
+/**
+ * @brief Packs a panel of B in micro-panels of GEMM_NR columns.
+ * 
+ * Every micro-panel stores, for each k, GEMM_NR contiguous elements of a row.
+ * Missing columns of the last micro-panel are padded with zeros.
+ * Inside a parallel region the micro-panels are shared among the threads.
+ * 
+ * @param matrixB Pointer to the top left element of the panel.
+ * @param ldb Leading dimension of B.
+ * @param kc Rows of the panel.
+ * @param nc Columns of the panel.
+ * @param packed Pointer to the output buffer.
+ */
+static void packPanelB(const elem_t* matrixB, int ldb, int kc, int nc, elem_t* packed){
+    #pragma omp for schedule(static)
+    for(int j = 0; j < nc; j += GEMM_NR){
+        int nr = nc - j < GEMM_NR ? nc - j : GEMM_NR;
+        elem_t* panel = packed + j*kc;
+        for(int k = 0; k < kc; k++){
+            const elem_t* row = matrixB + k*ldb + j;
+            for(int c = 0; c < nr; c++) panel[c] = row[c];
+            for(int c = nr; c < GEMM_NR; c++) panel[c] = 0;
+            panel += GEMM_NR;
+        }
+    }
+}
+
+/**
+ * @brief Computes a GEMM_MR*GEMM_NR block of C from two packed micro-panels.
+ * 
+ * The accumulators have a compile-time size, so they are kept in vector registers
+ * and the inner loop is fully vectorized by the compiler.
+ * 
+ * @param kc Depth of the micro-panels.
+ * @param packedA Pointer to the micro-panel of A.
+ * @param packedB Pointer to the micro-panel of B.
+ * @param matrixC Pointer to the top left element of the block of C.
+ * @param ldc Leading dimension of C.
+ * @param mr Valid rows of the block.
+ * @param nr Valid columns of the block.
+ */
+static inline void microKernel(int kc, const elem_t* restrict packedA, const elem_t* restrict packedB, elem_t* matrixC, int ldc, int mr, int nr){
+    elem_t acc[GEMM_MR][GEMM_NR] = {{0}};
+
+    for(int k = 0; k < kc; k++){
+        for(int r = 0; r < GEMM_MR; r++){
+            elem_t a = packedA[r];
+            for(int c = 0; c < GEMM_NR; c++){
+                acc[r][c] += a * packedB[c];
+            }
+        }
+        packedA += GEMM_MR;
+        packedB += GEMM_NR;
+    }
+
+    for(int r = 0; r < mr; r++){
+        for(int c = 0; c < nr; c++){
+            matrixC[r*ldc + c] += acc[r][c];
+        }
+    }
+}
+
+/**
+ * @brief Multiplies a packed panel of A by a packed panel of B.
+ * 
+ * This is the only hot function, so it is the one compiled once per instruction set.
+ * Inside a parallel region every thread takes its own micro-panels of B, which also
+ * keeps the blocks of C written by different threads apart.
+ * 
+ * @param mc Rows of the panel of A.
+ * @param nc Columns of the panel of B.
+ * @param kc Depth of the panels.
+ * @param packedA Pointer to the packed panel of A.
+ * @param packedB Pointer to the packed panel of B.
+ * @param matrixC Pointer to the top left element of the block of C.
+ * @param ldc Leading dimension of C.
+ */
+GEMM_CLONES
+static void macroKernel(int mc, int nc, int kc, const elem_t* packedA, const elem_t* packedB, elem_t* matrixC, int ldc){
+    #pragma omp for schedule(static)
+    for(int j = 0; j < nc; j += GEMM_NR){
+        int nr = nc - j < GEMM_NR ? nc - j : GEMM_NR;
+        for(int i = 0; i < mc; i += GEMM_MR){
+            int mr = mc - i < GEMM_MR ? mc - i : GEMM_MR;
+            microKernel(kc, packedA + i*kc, packedB + j*kc, matrixC + i*ldc + j, ldc, mr, nr);
+        }
+    }
+}
+
+/**
+ * @brief Allocates a buffer for a packed panel, aligned to the cache line.
+ *
+ * The size passed to aligned_alloc is rounded up to a multiple of the alignment, since
+ * the panel sizes set at runtime need not give one. The program exits on failure.
+ *
+ * @param count The number of elements of the panel.
+ * @return The pointer to the buffer.
+ */
+static elem_t* allocPacked(size_t count){
+    size_t bytes = (count*sizeof(elem_t) + 63) / 64 * 64;
+    elem_t* buffer = aligned_alloc(64, bytes);
+    if(buffer==NULL){
+        printf("Abort... error allocating memory.\n");
+        exit(2);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Multiplies two matrices and accumulates the result.
+ * 
+ * Small products, such as the single elements of the scalar DNS variant, use a plain
+ * i-k-j loop. Larger ones are tiled for L2 (mc*kc panel of A) and L3
+ * (kc*nc panel of B) and handed to the packed macro-kernel.
+ * The tiling loops run in a single parallel region when the product is large enough,
+ * the implicit barriers of the work-sharing loops keep the packed panels consistent.
+ * 
+ * @param matrixA Pointer to the first matrix.
+ * @param matrixB Pointer to the second matrix.
+ * @param matrixC Pointer to the result matrix.
+ * @param rows Number of rows of A and C.
+ * @param cols Number of columns of B and C.
+ * @param inner Number of columns of A and rows of B.
+ * @param lda Leading dimension of A.
+ * @param ldb Leading dimension of B.
+ * @param ldc Leading dimension of C.
+ */
+void gemmKernel(const elem_t* matrixA, const elem_t* matrixB, elem_t* matrixC, int rows, int cols, int inner, int lda, int ldb, int ldc){
+    if((long)rows*cols*inner <= GEMM_SMALL){
+        for(int i = 0; i < rows; i++){
+            for(int k = 0; k < inner; k++){
+                elem_t a = matrixA[i*lda+k];
+                for(int j = 0; j < cols; j++){
+                    matrixC[i*ldc+j] += a * matrixB[k*ldb+j];
+                }
+            }
+        }
+        return;
+    }
+
+    size_t aSize = (size_t)tileMC * tileKC;
+    if(aSize > packedASize){
+        free(packedA);
+        packedA = allocPacked(aSize);
+        packedASize = aSize;
+    }
+    int ncMax = cols < tileNC ? (cols + GEMM_NR - 1) / GEMM_NR * GEMM_NR : tileNC;
+    size_t bSize = (size_t)ncMax * tileKC;
+    if(bSize > packedBSize){
+        free(packedB);
+        packedB = allocPacked(bSize);
+        packedBSize = bSize;
+    }
+
+    #pragma omp parallel if((long)rows*cols*inner >= GEMM_PARALLEL)
+    for(int jc = 0; jc < cols; jc += tileNC){
+        int nc = cols - jc < tileNC ? cols - jc : tileNC;
+        for(int pc = 0; pc < inner; pc += tileKC){
+            int kc = inner - pc < tileKC ? inner - pc : tileKC;
+            packPanelB(matrixB + pc*ldb + jc, ldb, kc, nc, packedB);
+            for(int ic = 0; ic < rows; ic += tileMC){
+                int mc = rows - ic < tileMC ? rows - ic : tileMC;
+                packPanelA(matrixA + ic*lda + pc, lda, mc, kc, packedA);
+                macroKernel(mc, nc, kc, packedA, packedB, matrixC + ic*ldc + jc, ldc);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Changes the sizes of the packed panels used by the following products.
+ * 
+ * The buffers grow at the next product if the new panels do not fit.
+ * 
+ * @param mc The rows of the panel of A.
+ * @param kc The depth of the panels.
+ * @param nc The columns of the panel of B.
+ */
+void gemmSetTiles(int mc, int kc, int nc){
+    tileMC = mc < 1 ? GEMM_MC : (mc + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+    tileKC = kc < 1 ? GEMM_KC : kc;
+    tileNC = nc < 1 ? GEMM_NC : (nc + GEMM_NR - 1) / GEMM_NR * GEMM_NR;
+}
+
+/**
+ * @brief Reads the sizes of the packed panels in use.
+ * 
+ * @param mc The pointer receiving the rows of the panel of A.
+ * @param kc The pointer receiving the depth of the panels.
+ * @param nc The pointer receiving the columns of the panel of B.
+ */
+void gemmGetTiles(int* mc, int* kc, int* nc){
+    *mc = tileMC;
+    *kc = tileKC;
+    *nc = tileNC;
+}
+
+/**
+ * @brief Returns the name of the code path selected at runtime.
+ * 
+ * The checks follow the same priority used by the clones of the macro-kernel.
+ * 
+ * @return "avx512f", "avx2" or "default".
+ */
+const char* gemmKernelIsa(void){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return "avx512f";
+    if(__builtin_cpu_supports("avx2")) return "avx2";
+#endif
+    return "default";
+}
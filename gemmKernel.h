@@ -0,0 +1,99 @@
+/**
+ * @file gemmKernel.h
+ * @brief Header file containing the local matrix multiplication kernel.
+ *
+ * The kernel is shared by the sequential program and by the block based DNS variant.
+ */
+
+#ifndef GEMMKERNEL_H
+#define GEMMKERNEL_H
+
+#include "matrixType.h"
+
+/**
+ * @def GEMM_MR
+ * @brief Rows of the register block computed by the micro-kernel.
+ */
+
+/**
+ * @def GEMM_NR
+ * @brief Columns of the register block computed by the micro-kernel.
+ *
+ * The block is sized per element type so that its accumulators fit the vector registers.
+ */
+#if defined(DTYPE_COMPLEX)
+#define GEMM_MR 2
+#define GEMM_NR 4
+#elif defined(DTYPE_DOUBLE) || defined(DTYPE_INT64)
+#define GEMM_MR 6
+#define GEMM_NR 8
+#else
+#define GEMM_MR 6
+#define GEMM_NR 16
+#endif
+
+/**
+ * @def GEMM_MC
+ * @brief Default rows of the packed panel of A, sized to stay in L2 cache.
+ */
+#define GEMM_MC 96
+
+/**
+ * @def GEMM_KC
+ * @brief Default depth of the packed panels, sized so that a micro-panel of B stays in L1 cache.
+ */
+#define GEMM_KC 256
+
+/**
+ * @def GEMM_NC
+ * @brief Default columns of the packed panel of B.
+ */
+#define GEMM_NC 4096
+
+/**
+ * @brief Multiplies two matrices and accumulates the result.
+ * 
+ * Computes C += A * B, where A is rows*inner, B is inner*cols and C is rows*cols.
+ * All the matrices are stored in row-major order with the given leading dimensions.
+ * 
+ * @param matrixA Pointer to the first matrix.
+ * @param matrixB Pointer to the second matrix.
+ * @param matrixC Pointer to the result matrix.
+ * @param rows Number of rows of A and C.
+ * @param cols Number of columns of B and C.
+ * @param inner Number of columns of A and rows of B.
+ * @param lda Leading dimension of A.
+ * @param ldb Leading dimension of B.
+ * @param ldc Leading dimension of C.
+ */
+void gemmKernel(const elem_t* matrixA, const elem_t* matrixB, elem_t* matrixC, int rows, int cols, int inner, int lda, int ldb, int ldc);
+
+/**
+ * @brief Changes the sizes of the packed panels used by the following products.
+ * 
+ * mc is rounded up to a multiple of GEMM_MR and nc to a multiple of GEMM_NR; a value
+ * lower than 1 restores the default.
+ * 
+ * @param mc Rows of the panel of A.
+ * @param kc Depth of the panels.
+ * @param nc Columns of the panel of B.
+ */
+void gemmSetTiles(int mc, int kc, int nc);
+
+/**
+ * @brief Reads the sizes of the packed panels in use.
+ * 
+ * @param mc Pointer receiving the rows of the panel of A.
+ * @param kc Pointer receiving the depth of the panels.
+ * @param nc Pointer receiving the columns of the panel of B.
+ */
+void gemmGetTiles(int* mc, int* kc, int* nc);
+
+/**
+ * @brief Returns the name of the code path selected at runtime.
+ * 
+ * @return "avx512f", "avx2" or "default".
+ */
+const char* gemmKernelIsa(void);
+
+#endif // GEMMKERNEL_H
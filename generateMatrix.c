@@ -5,45 +5,65 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include "inOutUtils.h"
 
 /**
  * @brief The main function to generate and save matrices.
  * 
+ * With a single size the two matrices are square. With three sizes [rows] [inner] [cols]
+ * matrixA is rows*inner and matrixB is inner*cols. The layout of the files is chosen
+ * with -l row|col|block, the side of the blocks of the block layout with -b.
+ * The matrices are generated in chunks and written as they are produced, so they do not
+ * need to fit in memory.
+ * 
  * @param argc The number of command-line arguments.
  * @param argv An array of strings containing the command-line arguments.
  * @return 0 if the program executed successfully, otherwise a non-zero value.
  */
 int main(int argc, char* argv[]){    
-    if(argc != 2){
-        fprintf(stdout, "Usage: ./generateMatrix [size]\n");
-        return 1;
+    int layout = LAYOUT_ROW_MAJOR;
+    int blockSize = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "l:b:")) != -1){
+        switch(opt){
+            case 'l':
+                if(!strcmp(optarg, "row")) layout = LAYOUT_ROW_MAJOR;
+                else if(!strcmp(optarg, "col")) layout = LAYOUT_COL_MAJOR;
+                else if(!strcmp(optarg, "block")) layout = LAYOUT_BLOCK_MAJOR;
+                else layout = -1;
+                break;
+            case 'b':
+                blockSize = strtol(optarg, NULL, 10);
+                break;
+            default:
+                layout = -1;
+                break;
+        }
     }
-    int n = strtol(argv[1], NULL, 10);
 
-    // Matrices allocation
-    int* matrixA = malloc(n*n*sizeof(int));
-    int* matrixB = malloc(n*n*sizeof(int));
-    if(matrixA == NULL || matrixB == NULL){
-        fprintf(stdout, "Error allocating memory\n");
-        return 2;
+    int sizes = argc - optind;
+    if((sizes != 1 && sizes != 3) || layout < 0 || (layout == LAYOUT_BLOCK_MAJOR && blockSize <= 0)){
+        fprintf(stdout, "Usage: ./generateMatrix [-l row|col|block] [-b block size] [size] | [rows] [inner] [cols]\n");
+        return 1;
     }
+    int rows = strtol(argv[optind], NULL, 10);
+    int inner = sizes == 3 ? strtol(argv[optind+1], NULL, 10) : rows;
+    int cols = sizes == 3 ? strtol(argv[optind+2], NULL, 10) : rows;
 
-    // Generate matrices
-    generateMatrix(matrixA, matrixB, n);
-    
-    // Write matrices to files
-    if(writeMatrixToFile(matrixA, n, "matrixA.bin")){
+    // Generate the matrices straight into the files
+    if(generateMatrixFile(MATRIX_A, rows, inner, layout, blockSize, "matrixA.bin")){
         fprintf(stdout, "Error writing matrixA\n");
         return 3;
     }
 
-    if(writeMatrixToFile(matrixB, n, "matrixB.bin")){
+    if(generateMatrixFile(MATRIX_B, inner, cols, layout, blockSize, "matrixB.bin")){
         fprintf(stdout, "Error writing matrixB\n");
         return 3;
     }
 
     printf("Matrices generated and saved in matrixA.bin and matrixB.bin\n");
-
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,105 @@
+/**
+ * @file gridPlanner.c
+ * @brief This file contains the planner of the process grid.
+ *
+ * The DNS variant needs a q*q*m grid with m dividing q, so that every layer can be split
+ * in square submatrices for the Cannon shifts. The planner looks for the grid that uses
+ * the most processes out of the available ones; the remaining processes stay idle.
+ * The SUMMA engine accepts any rectangular grid, so it can almost always use them all.
+ */
+
+#include "gridPlanner.h"
+
+/**
+ * @brief Chooses the process grid for an n*n matrix and p processes.
+ * 
+ * Every q <= n and every m dividing q with q*q*m <= p is a candidate, as long as the
+ * padding does not leave a whole row of blocks empty. Among the candidates the planner
+ * prefers, in order: more processes, no padding, larger q (smaller blocks, so less memory
+ * per process). With p = n*n*m and n divisible by m this gives back q = n, the original
+ * one element per process layout.
+ * 
+ * @param n The size of the matrix.
+ * @param p The number of available processes.
+ * @param q The requested side of the layers, or 0 to choose it.
+ * @param m The requested number of layers, or 0 to choose it.
+ * @param plan Pointer to the plan to fill.
+ * @return 0 if a grid was found, 1 otherwise.
+ */
+int planGrid(int n, int p, int q, int m, GridPlan* plan){
+    int found = 0;
+
+    for(int cq = 1; cq <= n && (long)cq*cq <= p; cq++){
+        if(q && cq != q) continue;
+        int b = (n + cq - 1) / cq;
+        if((cq - 1) * b >= n) continue; //The last row of blocks would be only padding
+
+        for(int cm = 1; cm <= cq; cm++){
+            if(m && cm != m) continue;
+            if(cq % cm || (long)cq*cq*cm > p) continue;
+
+            int active = cq*cq*cm;
+            int padded = n % cq != 0;
+            int better = !found || active > plan->active ||
+                         (active == plan->active && padded < (n % plan->q != 0)) ||
+                         (active == plan->active && padded == (n % plan->q != 0) && cq > plan->q);
+            if(better){
+                plan->q = cq;
+                plan->m = cm;
+                plan->b = b;
+                plan->active = active;
+                found = 1;
+            }
+        }
+    }
+
+    return !found;
+}
+
+/**
+ * @brief Chooses the rectangular process grid for a rows*inner by inner*cols product and p processes.
+ * 
+ * Every gridRows <= rows and gridCols <= cols with gridRows*gridCols <= p is a candidate, as
+ * long as the padding does not leave a whole row or column of tiles of C empty. Among the
+ * candidates the planner prefers more processes, then the smallest tileRows + tileCols:
+ * every process receives inner*(tileRows + tileCols) elements in the panels, so the grid
+ * follows the shape of C.
+ * 
+ * @param rows The rows of A and C.
+ * @param inner The columns of A and rows of B.
+ * @param cols The columns of B and C.
+ * @param p The number of available processes.
+ * @param gridRows The requested rows of the grid, or 0 to choose them.
+ * @param gridCols The requested columns of the grid, or 0 to choose them.
+ * @param plan Pointer to the plan to fill.
+ * @return 0 if a grid was found, 1 otherwise.
+ */
+int planSummaGrid(int rows, int inner, int cols, int p, int gridRows, int gridCols, SummaPlan* plan){
+    int found = 0;
+    long bestTraffic = 0;
+
+    if(inner < 1) return 1;
+    for(int cr = 1; cr <= rows && cr <= p; cr++){
+        if(gridRows && cr != gridRows) continue;
+        int tileRows = (rows + cr - 1) / cr;
+        if((cr - 1) * tileRows >= rows) continue; //The last row of tiles would be only padding
+
+        for(int cc = 1; cc <= cols && (long)cr*cc <= p; cc++){
+            if(gridCols && cc != gridCols) continue;
+            int tileCols = (cols + cc - 1) / cc;
+            if((cc - 1) * tileCols >= cols) continue;
+
+            int active = cr*cc;
+            long traffic = (long)tileRows + tileCols;
+            if(!found || active > plan->active || (active == plan->active && traffic < bestTraffic)){
+                plan->gridRows = cr;
+                plan->gridCols = cc;
+                plan->active = active;
+                bestTraffic = traffic;
+                found = 1;
+            }
+        }
+    }
+
+    return !found;
+}
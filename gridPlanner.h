@@ -0,0 +1,60 @@
+/**
+ * @file gridPlanner.h
+ * @brief Header file containing the planner of the process grid.
+ */
+
+#ifndef GRIDPLANNER_H
+#define GRIDPLANNER_H
+
+/**
+ * @struct GridPlan
+ * @brief Shape of the process grid chosen for a matrix and a number of processes.
+ *
+ * The grid has q*q*m processes, each one owning a b*b block. When q does not divide n
+ * the matrix is padded with zeros up to q*b, but every row and column of blocks
+ * still holds at least one element of the matrix.
+ */
+typedef struct {
+    int q; /**< The side of each layer of the procs cube */
+    int m; /**< The depth of procs cube */
+    int b; /**< The side of the block owned by each process */
+    int active; /**< Number of processes in the grid, q*q*m */
+} GridPlan;
+
+/**
+ * @brief Chooses the process grid for an n*n matrix and p processes.
+ * 
+ * @param n Size of the matrix.
+ * @param p Number of available processes.
+ * @param q Requested side of the layers, or 0 to choose it.
+ * @param m Requested number of layers, or 0 to choose it.
+ * @param plan Pointer to the plan to fill.
+ * @return 0 if a grid was found, 1 otherwise.
+ */
+int planGrid(int n, int p, int q, int m, GridPlan* plan);
+
+/**
+ * @struct SummaPlan
+ * @brief Shape of the rectangular process grid chosen for the SUMMA engine.
+ */
+typedef struct {
+    int gridRows; /**< The number of rows of the grid */
+    int gridCols; /**< The number of columns of the grid */
+    int active; /**< Number of processes in the grid, gridRows*gridCols */
+} SummaPlan;
+
+/**
+ * @brief Chooses the rectangular process grid for a rows*inner by inner*cols product and p processes.
+ * 
+ * @param rows Rows of A and C.
+ * @param inner Columns of A and rows of B.
+ * @param cols Columns of B and C.
+ * @param p Number of available processes.
+ * @param gridRows Requested rows of the grid, or 0 to choose them.
+ * @param gridCols Requested columns of the grid, or 0 to choose them.
+ * @param plan Pointer to the plan to fill.
+ * @return 0 if a grid was found, 1 otherwise.
+ */
+int planSummaGrid(int rows, int inner, int cols, int p, int gridRows, int gridCols, SummaPlan* plan);
+
+#endif // GRIDPLANNER_H
@@ -1,12 +1,99 @@
 /**
  * @file inOutUtils.c
  * @brief This file contains functions for input/output operations on matrices.
+ *
+ * Matrix files start with a MatrixFileHeader and are accessed through mmap,
+ * so large inputs are not copied before being used.
+ *
+ * The random matrices come from a counter-based generator: every element is a hash of the
+ * seed, the matrix, its row and its column, so any piece of a matrix can be generated on its
+ * own, by any thread or process, and always gets the same values.
  */
 
 #include "inOutUtils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Mixes the bits of a 64 bit value (splitmix64 finalizer).
+ * 
+ * @param x The value to mix.
+ * @return The mixed value.
+ */
+static inline uint64_t mix64(uint64_t x){
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @def GENERATE_PARALLEL
+ * @brief Below this number of elements a tile is generated by a single thread.
+ */
+#define GENERATE_PARALLEL (1L << 16)
+
+/**
+ * @def GENERATE_CHUNK
+ * @brief Elements generated in memory at a time when a matrix is streamed to a file.
+ */
+#define GENERATE_CHUNK (1L << 20)
+
+/**
+ * @brief Returns the key shared by the elements of a row of a generated matrix.
+ * 
+ * @param matrix The matrix, see MatrixId.
+ * @param row The row.
+ * @return The key of the row.
+ */
+static inline uint64_t rowKey(int matrix, uint64_t row){
+    return mix64(mix64(SRAND_SEED + (uint64_t)matrix) ^ (row * 0xD1B54A32D192ED03ull));
+}
+
+/**
+ * @brief Returns an element of a generated matrix, between 0 and 9.
+ * 
+ * The range is reduced with a multiplication instead of a modulo, so that the loops
+ * calling this function are vectorized.
+ * 
+ * @param key The key of the row, see rowKey.
+ * @param col The column.
+ * @return The element.
+ */
+static inline elem_t generateEntry(uint64_t key, uint64_t col){
+    uint64_t bits = mix64(key + col * 0x9E3779B97F4A7C15ull);
+    return (elem_t)(((bits >> 32) * 10) >> 32);
+}
+
+/**
+ * @brief Generates a tile of a random matrix.
+ * 
+ * The rows are split among the OpenMP threads and every row is generated with SIMD.
+ * 
+ * @param matrix The matrix, see MatrixId.
+ * @param row The first row of the tile.
+ * @param col The first column of the tile.
+ * @param rows The number of rows of the tile.
+ * @param cols The number of columns of the tile.
+ * @param tile The pointer to the tile, in row-major order.
+ * @param ld The leading dimension of the tile.
+ */
+void generateMatrixTile(int matrix, size_t row, size_t col, int rows, int cols, elem_t* tile, int ld){
+    #pragma omp parallel for schedule(static) if((long)rows*cols >= GENERATE_PARALLEL)
+    for(int i = 0; i < rows; i++){
+        uint64_t key = rowKey(matrix, row + i);
+        elem_t* line = tile + (size_t)i*ld;
+        #pragma omp simd
+        for(int j = 0; j < cols; j++){
+            line[j] = generateEntry(key, col + j);
+        }
+    }
+}
 
 /**
  * @brief Generates random values for two matrices.
@@ -18,12 +105,25 @@
  * @param matrixB Pointer to the second matrix.
  * @param n The size of the matrices.
  */
-void generateMatrix(int* matrixA, int* matrixB, int n){
-    srand(SRAND_SEED);
-    for(int i=0; i<n*n; i++){
-        matrixA[i] = rand() % 10;
-        matrixB[i] = rand() % 10;
-    }
+void generateMatrix(elem_t* matrixA, elem_t* matrixB, int n){
+    generateRectMatrix(matrixA, matrixB, n, n, n);
+}
+
+/**
+ * @brief Generates random values for two matrices of any size.
+ * 
+ * Element (i, j) of each matrix does not depend on the sizes, so a square matrix is the
+ * top-left corner of any larger one.
+ * 
+ * @param matrixA Pointer to the first matrix, rows*inner.
+ * @param matrixB Pointer to the second matrix, inner*cols.
+ * @param rows The number of rows of the first matrix.
+ * @param inner The number of columns of the first matrix and of rows of the second.
+ * @param cols The number of columns of the second matrix.
+ */
+void generateRectMatrix(elem_t* matrixA, elem_t* matrixB, int rows, int inner, int cols){
+    generateMatrixTile(MATRIX_A, 0, 0, rows, inner, matrixA, inner);
+    generateMatrixTile(MATRIX_B, 0, 0, inner, cols, matrixB, cols);
 }
 
 /**
@@ -35,35 +135,401 @@ void generateMatrix(int* matrixA, int* matrixB, int n){
  * @param matrix Pointer to the matrix.
  * @param n The size of the matrix.
  */
-void printMatrix(int* matrix, int n){
-    printf("Matrix n: %d*%d\n", n, n);
-    for(int i = 0; i<n*n; i++){
-        if(i % n == 0) printf("\n");
-        printf("\t%d", matrix[i]);
+void printMatrix(elem_t* matrix, int n){
+    printRectMatrix(matrix, n, n);
+}
+
+/**
+ * @brief Prints the values of a rectangular matrix.
+ * 
+ * @param matrix Pointer to the matrix, in row-major order.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ */
+void printRectMatrix(elem_t* matrix, int rows, int cols){
+    printf("Matrix n: %d*%d\n", rows, cols);
+    for(size_t i = 0; i<(size_t)rows*cols; i++){
+        if(i % cols == 0) printf("\n");
+        printElement(matrix[i]);
     }
     printf("\n");
 }
 
+/**
+ * @brief Fills a header describing a matrix of elem_t.
+ * 
+ * The checksum is left to zero, writers fill it once the payload is known.
+ * 
+ * @param header Pointer to the header to fill.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param layout The order of the elements, see MatrixLayout.
+ * @param blockSize The side of the blocks for LAYOUT_BLOCK_MAJOR.
+ */
+void initMatrixHeader(MatrixFileHeader* header, int rows, int cols, int layout, int blockSize){
+    memset(header, 0, sizeof(MatrixFileHeader));
+    header->magic = MATRIX_MAGIC;
+    header->version = MATRIX_VERSION;
+    header->dtype = ELEM_TYPE;
+    header->elemSize = sizeof(elem_t);
+    header->rows = rows;
+    header->cols = cols;
+    header->layout = layout;
+    header->blockSize = layout == LAYOUT_BLOCK_MAJOR ? blockSize : 0;
+}
+
+/**
+ * @brief Checks that a header is valid and describes a rows*cols matrix of elem_t.
+ * 
+ * The element type must match the one the program was compiled for,
+ * no conversion is performed. Version 1 headers are accepted as row-major
+ * files without checksum.
+ * 
+ * @param header Pointer to the header read from a file.
+ * @param rows The expected number of rows, or -1 to accept any.
+ * @param cols The expected number of columns, or -1 to accept any.
+ * @return 0 if the header matches, 1 otherwise.
+ */
+int checkMatrixHeader(MatrixFileHeader* header, int rows, int cols){
+    if(header->magic != MATRIX_MAGIC || header->version < 1 || header->version > MATRIX_VERSION){
+        return 1;
+    }
+    if(header->version == 1){
+        header->layout = LAYOUT_ROW_MAJOR;
+        header->blockSize = 0;
+        header->checksum = 0;
+    }
+    if(header->dtype != ELEM_TYPE || header->elemSize != sizeof(elem_t)){
+        return 1;
+    }
+    if(header->layout > LAYOUT_BLOCK_MAJOR){
+        return 1;
+    }
+    if(header->layout == LAYOUT_BLOCK_MAJOR &&
+       (header->blockSize == 0 || header->rows % header->blockSize || header->cols % header->blockSize)){
+        return 1;
+    }
+    return (rows >= 0 && header->rows != (uint64_t)rows) || (cols >= 0 && header->cols != (uint64_t)cols);
+}
+
+/**
+ * @brief Position of element (i, j) inside the payload described by a header.
+ * 
+ * @param header Pointer to the header.
+ * @param i The row of the element.
+ * @param j The column of the element.
+ * @return Offset of the element, in elements.
+ */
+size_t matrixElementOffset(const MatrixFileHeader* header, size_t i, size_t j){
+    size_t bs = header->blockSize;
+    switch(header->layout){
+        case LAYOUT_COL_MAJOR:
+            return j*header->rows + i;
+        case LAYOUT_BLOCK_MAJOR:
+            return ((i/bs)*(header->cols/bs) + j/bs)*bs*bs + (i%bs)*bs + j%bs;
+        default:
+            return i*header->cols + j;
+    }
+}
+
+/**
+ * @brief Computes the checksum of a piece of payload.
+ * 
+ * Every 32 bit word is hashed together with its position and the hashes are summed,
+ * so processes can checksum their own pieces and add the results.
+ * 
+ * @param data Pointer to the piece of payload.
+ * @param bytes The size of the piece, a multiple of 4.
+ * @param firstWord The position of the first word of the piece inside the payload.
+ * @return The checksum of the piece.
+ */
+uint64_t matrixChecksum(const void* data, size_t bytes, uint64_t firstWord){
+    const uint32_t* words = data;
+    uint64_t sum = 0;
+    for(size_t i = 0; i < bytes / sizeof(uint32_t); i++){
+        sum += mix64(mix64(firstWord + i) + words[i]);
+    }
+    return sum;
+}
+
+/**
+ * @brief Reads and validates the header of a matrix file.
+ * 
+ * @param header Pointer to the header to fill.
+ * @param filename The name of the file to read from.
+ * @return 0 if the header was read and is valid, 1 otherwise.
+ */
+int readMatrixInfo(MatrixFileHeader* header, char* filename){
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 1;
+    }
+    size_t count = fread(header, sizeof(MatrixFileHeader), 1, file);
+    fclose(file);
+    return count != 1 || checkMatrixHeader(header, -1, -1);
+}
+
+/**
+ * @brief Maps a matrix file in memory, without copying its payload.
+ * 
+ * The file is rejected if its header is not valid or if it is too small for the payload
+ * the header describes. The mapping is read-only and the kernel is told that it will be
+ * read sequentially.
+ * 
+ * @param mapped Pointer to the struct to fill.
+ * @param filename The name of the file to map.
+ * @param verify If not zero, the checksum of the payload is verified.
+ * @return 0 if the file was successfully mapped, 1 otherwise.
+ */
+int mapMatrixFile(MappedMatrix* mapped, char* filename, int verify){
+    struct stat info;
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0){
+        return 1;
+    }
+    if(fstat(fd, &info) || (size_t)info.st_size < sizeof(MatrixFileHeader)){
+        close(fd);
+        return 1;
+    }
+
+    mapped->mappingSize = info.st_size;
+    mapped->mapping = mmap(NULL, mapped->mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped->mapping == MAP_FAILED){
+        return 1;
+    }
+
+    memcpy(&mapped->header, mapped->mapping, sizeof(MatrixFileHeader));
+    mapped->data = (elem_t*)((char*)mapped->mapping + sizeof(MatrixFileHeader));
+    //The payload is compared with the bytes after the header by division, so a header
+    //claiming huge dimensions cannot overflow the product
+    size_t available = mapped->mappingSize - sizeof(MatrixFileHeader);
+    uint64_t rows = mapped->header.rows;
+    uint64_t cols = mapped->header.cols;
+    if(checkMatrixHeader(&mapped->header, -1, -1) || (cols && rows > available / sizeof(elem_t) / cols)){
+        unmapMatrixFile(mapped);
+        return 1;
+    }
+    size_t payload = (size_t)(rows * cols * sizeof(elem_t));
+    madvise(mapped->mapping, mapped->mappingSize, MADV_SEQUENTIAL);
+
+    if(verify && mapped->header.version > 1 && matrixChecksum(mapped->data, payload, 0) != mapped->header.checksum){
+        unmapMatrixFile(mapped);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Unmaps a file mapped with mapMatrixFile.
+ * 
+ * @param mapped Pointer to the mapped matrix.
+ */
+void unmapMatrixFile(MappedMatrix* mapped){
+    munmap(mapped->mapping, mapped->mappingSize);
+    mapped->mapping = NULL;
+    mapped->data = NULL;
+}
+
+/**
+ * @brief Reads exactly the requested bytes at an offset, retrying short reads.
+ * 
+ * @param fd The descriptor of the file.
+ * @param buffer The buffer receiving the bytes.
+ * @param bytes The number of bytes to read.
+ * @param offset The position of the first byte in the file.
+ * @return 0 if every byte was read, 1 otherwise.
+ */
+static int preadFull(int fd, void* buffer, size_t bytes, off_t offset){
+    while(bytes > 0){
+        ssize_t done = pread(fd, buffer, bytes, offset);
+        if(done <= 0) return 1;
+        buffer = (char*)buffer + done;
+        bytes -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes exactly the requested bytes at an offset, retrying short writes.
+ * 
+ * @param fd The descriptor of the file.
+ * @param buffer The bytes to write.
+ * @param bytes The number of bytes to write.
+ * @param offset The position of the first byte in the file.
+ * @return 0 if every byte was written, 1 otherwise.
+ */
+static int pwriteFull(int fd, const void* buffer, size_t bytes, off_t offset){
+    while(bytes > 0){
+        ssize_t done = pwrite(fd, buffer, bytes, offset);
+        if(done <= 0) return 1;
+        buffer = (const char*)buffer + done;
+        bytes -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+/**
+ * @brief Number of elements of a row, from column j, stored next to each other in the file.
+ * 
+ * @param header The pointer to the header.
+ * @param j The first column.
+ * @param cols The number of columns wanted.
+ * @return The length of the run, at most cols.
+ */
+static size_t contiguousRun(const MatrixFileHeader* header, size_t j, size_t cols){
+    if(header->layout == LAYOUT_COL_MAJOR) return 1;
+    if(header->layout == LAYOUT_BLOCK_MAJOR){
+        size_t left = header->blockSize - j % header->blockSize;
+        return left < cols ? left : cols;
+    }
+    return cols;
+}
+
+/**
+ * @brief Verifies the checksum of an open matrix file, reading it in chunks.
+ * 
+ * Only one chunk is in memory at a time, so files larger than the memory can be checked.
+ * 
+ * @param fd The descriptor of the file, open for reading.
+ * @param header The header of the file.
+ * @return 0 if the checksum matches (or the version has none), 1 otherwise.
+ */
+int verifyMatrixFile(int fd, const MatrixFileHeader* header){
+    size_t chunk = 1 << 22;
+    size_t payload = header->rows * header->cols * sizeof(elem_t);
+    uint64_t sum = 0;
+    if(header->version < 2) return 0;
+
+    void* buffer = malloc(chunk);
+    if(buffer == NULL) return 1;
+    for(size_t done = 0; done < payload; done += chunk){
+        size_t bytes = payload - done < chunk ? payload - done : chunk;
+        if(preadFull(fd, buffer, bytes, sizeof(MatrixFileHeader) + done)){
+            free(buffer);
+            return 1;
+        }
+        sum += matrixChecksum(buffer, bytes, done / sizeof(uint32_t));
+    }
+    free(buffer);
+    return sum != header->checksum;
+}
+
+/**
+ * @brief Reads a tile of an open matrix file, in any layout.
+ * 
+ * Row-major and block-major files are read one contiguous run of a row at a time,
+ * column-major files one column of the tile at a time.
+ * 
+ * @param fd The descriptor of the file, open for reading.
+ * @param header The header of the file.
+ * @param row The first row of the tile.
+ * @param col The first column of the tile.
+ * @param rows The number of rows of the tile.
+ * @param cols The number of columns of the tile.
+ * @param tile The pointer to the tile, in row-major order.
+ * @param ld The leading dimension of the tile.
+ * @return 0 if the tile was read, 1 otherwise.
+ */
+int readMatrixTile(int fd, const MatrixFileHeader* header, size_t row, size_t col, int rows, int cols, elem_t* tile, int ld){
+    if(header->layout == LAYOUT_COL_MAJOR){
+        elem_t* column = malloc(rows*sizeof(elem_t));
+        if(column == NULL) return 1;
+        for(int j = 0; j < cols; j++){
+            off_t offset = sizeof(MatrixFileHeader) + matrixElementOffset(header, row, col + j)*sizeof(elem_t);
+            if(preadFull(fd, column, rows*sizeof(elem_t), offset)){
+                free(column);
+                return 1;
+            }
+            for(int i = 0; i < rows; i++) tile[(size_t)i*ld + j] = column[i];
+        }
+        free(column);
+        return 0;
+    }
+
+    for(int i = 0; i < rows; i++){
+        for(size_t j = 0, run; j < (size_t)cols; j += run){
+            run = contiguousRun(header, col + j, cols - j);
+            off_t offset = sizeof(MatrixFileHeader) + matrixElementOffset(header, row + i, col + j)*sizeof(elem_t);
+            if(preadFull(fd, tile + (size_t)i*ld + j, run*sizeof(elem_t), offset)) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a tile into an open matrix file, in any layout.
+ * 
+ * The tile is written one contiguous run of a row at a time, and every run is added
+ * to the checksum at its own position.
+ * 
+ * @param fd The descriptor of the file, open for writing.
+ * @param header The header of the file.
+ * @param row The first row of the tile.
+ * @param col The first column of the tile.
+ * @param rows The number of rows of the tile.
+ * @param cols The number of columns of the tile.
+ * @param tile The pointer to the tile, in row-major order.
+ * @param ld The leading dimension of the tile.
+ * @param checksum The pointer to the running checksum of the payload.
+ * @return 0 if the tile was written, 1 otherwise.
+ */
+int writeMatrixTile(int fd, const MatrixFileHeader* header, size_t row, size_t col, int rows, int cols, const elem_t* tile, int ld, uint64_t* checksum){
+    for(int i = 0; i < rows; i++){
+        for(size_t j = 0, run; j < (size_t)cols; j += run){
+            run = contiguousRun(header, col + j, cols - j);
+            size_t position = matrixElementOffset(header, row + i, col + j)*sizeof(elem_t);
+            const elem_t* data = tile + (size_t)i*ld + j;
+            if(pwriteFull(fd, data, run*sizeof(elem_t), sizeof(MatrixFileHeader) + position)) return 1;
+            *checksum += matrixChecksum(data, run*sizeof(elem_t), position / sizeof(uint32_t));
+        }
+    }
+    return 0;
+}
+
 /**
  * @brief Reads a matrix from a file.
  * 
  * This function reads a matrix of size n x n from a binary file.
  * The matrix is stored in the provided array matrix.
+ * The header of the file must describe an n x n matrix of the compiled element type.
  * 
  * @param matrix Pointer to the matrix.
  * @param n The size of the matrix.
  * @param filename The name of the file to read from.
  * @return 0 if the file was successfully read, 1 otherwise.
  */
-int readMatrixFromFile(int* matrix, int n, char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (file == NULL) {
+int readMatrixFromFile(elem_t* matrix, int n, char* filename) {
+    return readRectMatrixFromFile(matrix, n, n, filename);
+}
+
+/**
+ * @brief Reads a rectangular matrix from a file, in any layout, into row-major order.
+ * 
+ * The file is mapped and its checksum verified, then the payload is copied
+ * or reordered into the provided array.
+ * 
+ * @param matrix Pointer to the matrix.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param filename The name of the file to read from.
+ * @return 0 if the file was successfully read, 1 otherwise.
+ */
+int readRectMatrixFromFile(elem_t* matrix, int rows, int cols, char* filename){
+    MappedMatrix mapped;
+    if(mapMatrixFile(&mapped, filename, 1)){
+        return 1;
+    }
+    if(checkMatrixHeader(&mapped.header, rows, cols)){
+        unmapMatrixFile(&mapped);
         return 1;
     }
 
-    fread(matrix, sizeof(int), n*n, file);
+    mappedMatrixToRowMajor(&mapped, matrix);
 
-    fclose(file);
+    unmapMatrixFile(&mapped);
     return 0;
 }
 
@@ -71,20 +537,233 @@ int readMatrixFromFile(int* matrix, int n, char* filename) {
  * @brief Writes a matrix to a file.
  * 
  * This function writes a matrix of size n x n to a binary file.
- * The matrix is stored in the provided array matrix.
+ * The matrix is stored in the provided array matrix, after a header recording
+ * its size and element type.
  * 
  * @param matrix Pointer to the matrix.
  * @param n The size of the matrix.
  * @param filename The name of the file to write to.
  * @return 0 if the file was successfully written, 1 otherwise.
  */
-int writeMatrixToFile(int* matrix, int n, char* filename) {
-    FILE* file = fopen(filename, "wb");
-    if (file == NULL) {
+int writeMatrixToFile(elem_t* matrix, int n, char* filename) {
+    return writeRectMatrixToFile(matrix, n, n, LAYOUT_ROW_MAJOR, 0, filename);
+}
+
+/**
+ * @brief Writes a rectangular row-major matrix to a file, in the given layout.
+ * 
+ * The file is sized and mapped, the payload is stored straight into the mapping
+ * in the requested order, and the checksum is added to the header at the end.
+ * 
+ * @param matrix Pointer to the matrix, in row-major order.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param layout The order of the elements in the file, see MatrixLayout.
+ * @param blockSize The side of the blocks for LAYOUT_BLOCK_MAJOR.
+ * @param filename The name of the file to write to.
+ * @return 0 if the file was successfully written, 1 otherwise.
+ */
+int writeRectMatrixToFile(elem_t* matrix, int rows, int cols, int layout, int blockSize, char* filename){
+    MatrixFileHeader header;
+    initMatrixHeader(&header, rows, cols, layout, blockSize);
+    if(checkMatrixHeader(&header, rows, cols)){
         return 1;
     }
 
-    fwrite(matrix, sizeof(int), n*n, file);
-    fclose(file);
-    return 0;
-}
\ No newline at end of file
+    size_t payload = (size_t)rows*cols*sizeof(elem_t);
+    size_t size = sizeof(MatrixFileHeader) + payload;
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        return 1;
+    }
+    if(ftruncate(fd, size)){
+        close(fd);
+        return 1;
+    }
+    char* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED){
+        return 1;
+    }
+
+    elem_t* data = (elem_t*)(mapping + sizeof(MatrixFileHeader));
+    if(layout == LAYOUT_ROW_MAJOR){
+        memcpy(data, matrix, payload);
+    }else{
+        for(size_t i = 0; i < (size_t)rows; i++){
+            for(size_t j = 0; j < (size_t)cols; j++){
+                data[matrixElementOffset(&header, i, j)] = matrix[i*cols+j];
+            }
+        }
+    }
+    header.checksum = matrixChecksum(data, payload, 0);
+    memcpy(mapping, &header, sizeof(MatrixFileHeader));
+
+    return munmap(mapping, size) != 0;
+}
+
+/**
+ * @brief Reorders a matrix so that each block of a q*q grid is contiguous.
+ * 
+ * The matrix is split in q*q square blocks of size b = ceil(n/q). Block (i, j) is copied
+ * at position i*q+j of the output buffer, with its elements in row-major order.
+ * This is the layout expected by a scatter of one block per process.
+ * If q does not divide n, the elements of the blocks beyond the matrix are set to zero.
+ * 
+ * @param matrix Pointer to the matrix in row-major order.
+ * @param blocks Pointer to the output buffer, of q*q*b*b elements.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side.
+ */
+void matrixToBlocks(elem_t* matrix, elem_t* blocks, int n, int q){
+    int b = (n + q - 1) / q;
+    if(n % q) memset(blocks, 0, (size_t)q*q*b*b*sizeof(elem_t));
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < n; j++){
+            int block = (i / b) * q + j / b;
+            blocks[(size_t)block*b*b + (i % b)*b + j % b] = matrix[(size_t)i*n+j];
+        }
+    }
+}
+
+/**
+ * @brief Rebuilds a row-major matrix from its blocks.
+ * 
+ * This function is the inverse of matrixToBlocks, the padding of the blocks is dropped.
+ * 
+ * @param blocks Pointer to the blocks.
+ * @param matrix Pointer to the output matrix.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side.
+ */
+void blocksToMatrix(elem_t* blocks, elem_t* matrix, int n, int q){
+    int b = (n + q - 1) / q;
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < n; j++){
+            int block = (i / b) * q + j / b;
+            matrix[(size_t)i*n+j] = blocks[(size_t)block*b*b + (i % b)*b + j % b];
+        }
+    }
+}
+
+/**
+ * @brief Copies a mapped matrix, in any layout, into row-major order.
+ * 
+ * @param mapped Pointer to the mapped matrix.
+ * @param matrix Pointer to the output matrix.
+ */
+void mappedMatrixToRowMajor(MappedMatrix* mapped, elem_t* matrix){
+    size_t rows = mapped->header.rows;
+    size_t cols = mapped->header.cols;
+    if(mapped->header.layout == LAYOUT_ROW_MAJOR){
+        memcpy(matrix, mapped->data, rows*cols*sizeof(elem_t));
+        return;
+    }
+    for(size_t i = 0; i < rows; i++){
+        for(size_t j = 0; j < cols; j++){
+            matrix[i*cols+j] = mapped->data[matrixElementOffset(&mapped->header, i, j)];
+        }
+    }
+}
+
+/**
+ * @brief Copies the blocks of a mapped n*n matrix, in the order produced by matrixToBlocks.
+ * 
+ * Row-major files go through matrixToBlocks, block-major files with the same block size
+ * are copied as they are, any other layout is reordered element by element.
+ * Blocks are padded with zeros as in matrixToBlocks.
+ * 
+ * @param mapped Pointer to the mapped matrix.
+ * @param blocks Pointer to the output buffer.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side.
+ */
+void mappedMatrixToBlocks(MappedMatrix* mapped, elem_t* blocks, int n, int q){
+    int b = (n + q - 1) / q;
+    if(mapped->header.layout == LAYOUT_ROW_MAJOR){
+        matrixToBlocks(mapped->data, blocks, n, q);
+    }else if(mapped->header.layout == LAYOUT_BLOCK_MAJOR && mapped->header.blockSize == (uint32_t)b && n % q == 0){
+        memcpy(blocks, mapped->data, (size_t)n*n*sizeof(elem_t));
+    }else{
+        if(n % q) memset(blocks, 0, (size_t)q*q*b*b*sizeof(elem_t));
+        for(int i = 0; i < n; i++){
+            for(int j = 0; j < n; j++){
+                int block = (i / b) * q + j / b;
+                blocks[(size_t)block*b*b + (i % b)*b + j % b] = mapped->data[matrixElementOffset(&mapped->header, i, j)];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Generates a random matrix straight into a file, in any layout.
+ * 
+ * The payload is produced in file order, GENERATE_CHUNK elements at a time, so the matrix
+ * never needs to fit in memory. The chunk is split in lines of elements that are contiguous
+ * in the file (a row, a column, or a row of a block) and the lines are generated in parallel;
+ * the checksum is accumulated chunk by chunk and the header is written last.
+ * 
+ * @param matrix The matrix, see MatrixId.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param layout The order of the elements in the file, see MatrixLayout.
+ * @param blockSize The side of the blocks for LAYOUT_BLOCK_MAJOR, ignored otherwise.
+ * @param filename The name of the file to write to.
+ * @return 0 if the matrix was successfully written, 1 otherwise.
+ */
+int generateMatrixFile(int matrix, int rows, int cols, int layout, int blockSize, char* filename){
+    MatrixFileHeader header;
+    uint64_t checksum = 0;
+    int status = 0;
+
+    initMatrixHeader(&header, rows, cols, layout, blockSize);
+    if(checkMatrixHeader(&header, rows, cols)){
+        return 1;
+    }
+
+    size_t length = layout == LAYOUT_COL_MAJOR ? (size_t)rows : layout == LAYOUT_BLOCK_MAJOR ? (size_t)blockSize : (size_t)cols;
+    size_t lines = (size_t)rows*cols / length;
+    size_t chunkLines = length < GENERATE_CHUNK ? GENERATE_CHUNK / length : 1;
+    size_t blocksPerRow = layout == LAYOUT_BLOCK_MAJOR ? cols / blockSize : 1;
+
+    elem_t* chunk = malloc(chunkLines*length*sizeof(elem_t));
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(chunk == NULL || fd < 0 || ftruncate(fd, sizeof(MatrixFileHeader) + (size_t)rows*cols*sizeof(elem_t))){
+        free(chunk);
+        if(fd >= 0) close(fd);
+        return 1;
+    }
+
+    for(size_t first = 0; first < lines && !status; first += chunkLines){
+        size_t count = lines - first < chunkLines ? lines - first : chunkLines;
+
+        #pragma omp parallel for schedule(static)
+        for(size_t l = 0; l < count; l++){
+            size_t line = first + l;
+            elem_t* data = chunk + l*length;
+            if(layout == LAYOUT_COL_MAJOR){
+                for(size_t t = 0; t < length; t++) data[t] = generateEntry(rowKey(matrix, t), line);
+            }else{
+                size_t i = line, j = 0;
+                if(layout == LAYOUT_BLOCK_MAJOR){
+                    size_t block = line / blockSize;
+                    i = block / blocksPerRow * blockSize + line % blockSize;
+                    j = block % blocksPerRow * blockSize;
+                }
+                uint64_t key = rowKey(matrix, i);
+                #pragma omp simd
+                for(size_t t = 0; t < length; t++) data[t] = generateEntry(key, j + t);
+            }
+        }
+
+        size_t bytes = count*length*sizeof(elem_t);
+        size_t position = first*length*sizeof(elem_t);
+        status = pwriteFull(fd, chunk, bytes, sizeof(MatrixFileHeader) + position);
+        checksum += matrixChecksum(chunk, bytes, position / sizeof(uint32_t));
+    }
+
+    header.checksum = checksum;
+    if(!status) status = pwriteFull(fd, &header, sizeof(MatrixFileHeader), 0);
+    free(chunk);
+    return close(fd) != 0 || status;
+}
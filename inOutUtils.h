@@ -6,12 +6,194 @@
 #ifndef INOUTUTILS_H
 #define INOUTUTILS_H
 
+#include <stddef.h>
+#include "matrixType.h"
+
 /**
  * @def SRAND_SEED
- * @brief Seed value for srand function.
+ * @brief Seed of the generator of the random matrices.
  */
 #define SRAND_SEED 12345678
 
+/**
+ * @enum MatrixId
+ * @brief Matrices of a product, each one with its own stream of random values.
+ */
+enum MatrixId{
+    MATRIX_A = 0, /**< First factor */
+    MATRIX_B = 1 /**< Second factor */
+};
+
+/**
+ * @def MATRIX_MAGIC
+ * @brief Magic number at the beginning of every matrix file ("DNSM").
+ */
+#define MATRIX_MAGIC 0x4D534E44u
+
+/**
+ * @def MATRIX_VERSION
+ * @brief Version of the matrix file format.
+ *
+ * Version 1 files (row-major, without checksum) are still accepted by the readers.
+ */
+#define MATRIX_VERSION 2
+
+/**
+ * @enum MatrixLayout
+ * @brief Order of the elements in the payload of a matrix file.
+ */
+enum MatrixLayout{
+    LAYOUT_ROW_MAJOR = 0, /**< Row after row */
+    LAYOUT_COL_MAJOR = 1, /**< Column after column */
+    LAYOUT_BLOCK_MAJOR = 2 /**< Square blocks of blockSize in row-major grid order, each block in row-major order */
+};
+
+/**
+ * @struct MatrixFileHeader
+ * @brief Header stored at the beginning of every matrix file.
+ *
+ * The header has a fixed size of 64 bytes, the elements follow in the recorded layout.
+ * The reserved bytes are zero and leave room for future versions of the format.
+ */
+typedef struct {
+    uint32_t magic; /**< Always MATRIX_MAGIC */
+    uint32_t version; /**< Version of the format, MATRIX_VERSION */
+    uint32_t dtype; /**< Type of the elements, see ElementType */
+    uint32_t elemSize; /**< Size in bytes of each element */
+    uint64_t rows; /**< Number of rows */
+    uint64_t cols; /**< Number of columns */
+    uint32_t layout; /**< Order of the elements, see MatrixLayout */
+    uint32_t blockSize; /**< Side of the blocks for LAYOUT_BLOCK_MAJOR, 0 otherwise */
+    uint64_t checksum; /**< Checksum of the payload, see matrixChecksum */
+    uint8_t reserved[16]; /**< Reserved for future use */
+} MatrixFileHeader;
+
+_Static_assert(sizeof(MatrixFileHeader) == 64, "MatrixFileHeader must be 64 bytes");
+
+/**
+ * @struct MappedMatrix
+ * @brief A matrix file mapped in memory.
+ */
+typedef struct {
+    MatrixFileHeader header; /**< Copy of the header of the file */
+    elem_t* data; /**< Pointer to the payload inside the mapping */
+    void* mapping; /**< Start of the mapping */
+    size_t mappingSize; /**< Size of the mapping in bytes */
+} MappedMatrix;
+
+/**
+ * @brief Fills a header describing a matrix of elem_t.
+ * 
+ * @param header Pointer to the header to fill.
+ * @param rows Number of rows of the matrix.
+ * @param cols Number of columns of the matrix.
+ * @param layout Order of the elements, see MatrixLayout.
+ * @param blockSize Side of the blocks for LAYOUT_BLOCK_MAJOR, ignored otherwise.
+ */
+void initMatrixHeader(MatrixFileHeader* header, int rows, int cols, int layout, int blockSize);
+
+/**
+ * @brief Checks that a header is valid and describes a rows*cols matrix of elem_t.
+ * 
+ * @param header Pointer to the header read from a file.
+ * @param rows Expected number of rows, or -1 to accept any.
+ * @param cols Expected number of columns, or -1 to accept any.
+ * @return 0 if the header matches, 1 otherwise.
+ */
+int checkMatrixHeader(MatrixFileHeader* header, int rows, int cols);
+
+/**
+ * @brief Position of element (i, j) inside the payload described by a header.
+ * 
+ * @param header Pointer to the header.
+ * @param i Row of the element.
+ * @param j Column of the element.
+ * @return Offset of the element, in elements.
+ */
+size_t matrixElementOffset(const MatrixFileHeader* header, size_t i, size_t j);
+
+/**
+ * @brief Computes the checksum of a piece of payload.
+ * 
+ * The checksum is a sum of hashed 32 bit words, each combined with its position,
+ * so the checksums of separate pieces can be added together.
+ * 
+ * @param data Pointer to the piece of payload.
+ * @param bytes Size of the piece, a multiple of 4.
+ * @param firstWord Position of the first word of the piece inside the payload.
+ * @return The checksum of the piece.
+ */
+uint64_t matrixChecksum(const void* data, size_t bytes, uint64_t firstWord);
+
+/**
+ * @brief Reads and validates the header of a matrix file.
+ * 
+ * @param header Pointer to the header to fill.
+ * @param filename Name of the file to read from.
+ * @return 0 if the header was read and is valid, 1 otherwise.
+ */
+int readMatrixInfo(MatrixFileHeader* header, char* filename);
+
+/**
+ * @brief Maps a matrix file in memory, without copying its payload.
+ * 
+ * @param mapped Pointer to the struct to fill.
+ * @param filename Name of the file to map.
+ * @param verify If not zero, the checksum of the payload is verified.
+ * @return 0 if the file was successfully mapped, 1 otherwise.
+ */
+int mapMatrixFile(MappedMatrix* mapped, char* filename, int verify);
+
+/**
+ * @brief Unmaps a file mapped with mapMatrixFile.
+ * 
+ * @param mapped Pointer to the mapped matrix.
+ */
+void unmapMatrixFile(MappedMatrix* mapped);
+
+/**
+ * @brief Verifies the checksum of an open matrix file, reading it in chunks.
+ * 
+ * @param fd Descriptor of the file, open for reading.
+ * @param header Header of the file.
+ * @return 0 if the checksum matches (or the version has none), 1 otherwise.
+ */
+int verifyMatrixFile(int fd, const MatrixFileHeader* header);
+
+/**
+ * @brief Reads a tile of an open matrix file, in any layout.
+ * 
+ * @param fd Descriptor of the file, open for reading.
+ * @param header Header of the file.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Number of rows of the tile.
+ * @param cols Number of columns of the tile.
+ * @param tile Pointer to the tile, in row-major order.
+ * @param ld Leading dimension of the tile.
+ * @return 0 if the tile was read, 1 otherwise.
+ */
+int readMatrixTile(int fd, const MatrixFileHeader* header, size_t row, size_t col, int rows, int cols, elem_t* tile, int ld);
+
+/**
+ * @brief Writes a tile into an open matrix file, in any layout.
+ * 
+ * The checksum of the written elements is added to checksum, so that the header can be
+ * completed once every tile has been written.
+ * 
+ * @param fd Descriptor of the file, open for writing and already of the final size.
+ * @param header Header of the file.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Number of rows of the tile.
+ * @param cols Number of columns of the tile.
+ * @param tile Pointer to the tile, in row-major order.
+ * @param ld Leading dimension of the tile.
+ * @param checksum Pointer to the running checksum of the payload.
+ * @return 0 if the tile was written, 1 otherwise.
+ */
+int writeMatrixTile(int fd, const MatrixFileHeader* header, size_t row, size_t col, int rows, int cols, const elem_t* tile, int ld, uint64_t* checksum);
+
 /**
  * @brief Generates two matrices of size n and fills them with random values.
  * 
@@ -19,7 +201,47 @@
  * @param matrixB Pointer to the second matrix.
  * @param n Size of the matrices.
  */
-void generateMatrix(int* matrixA, int* matrixB, int n);
+void generateMatrix(elem_t* matrixA, elem_t* matrixB, int n);
+
+/**
+ * @brief Generates two matrices of any size and fills them with random values.
+ * 
+ * @param matrixA Pointer to the first matrix, rows*inner.
+ * @param matrixB Pointer to the second matrix, inner*cols.
+ * @param rows Number of rows of the first matrix.
+ * @param inner Number of columns of the first matrix and of rows of the second.
+ * @param cols Number of columns of the second matrix.
+ */
+void generateRectMatrix(elem_t* matrixA, elem_t* matrixB, int rows, int inner, int cols);
+
+/**
+ * @brief Generates a tile of a random matrix.
+ * 
+ * Element (i, j) of a matrix only depends on the matrix, i and j, so the tiles of a matrix
+ * can be generated separately and in any order.
+ * 
+ * @param matrix Matrix to generate, see MatrixId.
+ * @param row First row of the tile.
+ * @param col First column of the tile.
+ * @param rows Number of rows of the tile.
+ * @param cols Number of columns of the tile.
+ * @param tile Pointer to the tile, in row-major order.
+ * @param ld Leading dimension of the tile.
+ */
+void generateMatrixTile(int matrix, size_t row, size_t col, int rows, int cols, elem_t* tile, int ld);
+
+/**
+ * @brief Generates a random matrix straight into a file, without holding it in memory.
+ * 
+ * @param matrix Matrix to generate, see MatrixId.
+ * @param rows Number of rows of the matrix.
+ * @param cols Number of columns of the matrix.
+ * @param layout Order of the elements in the file, see MatrixLayout.
+ * @param blockSize Side of the blocks for LAYOUT_BLOCK_MAJOR, must divide rows and cols.
+ * @param filename Name of the file to write to.
+ * @return 0 if the matrix was successfully written, 1 otherwise.
+ */
+int generateMatrixFile(int matrix, int rows, int cols, int layout, int blockSize, char* filename);
 
 /**
  * @brief Prints the values of a matrix.
@@ -27,7 +249,16 @@ void generateMatrix(int* matrixA, int* matrixB, int n);
  * @param matrix Pointer to the matrix.
  * @param n Size of the matrix.
  */
-void printMatrix(int* matrix, int n);
+void printMatrix(elem_t* matrix, int n);
+
+/**
+ * @brief Prints the values of a rectangular matrix.
+ * 
+ * @param matrix Pointer to the matrix, in row-major order.
+ * @param rows Number of rows of the matrix.
+ * @param cols Number of columns of the matrix.
+ */
+void printRectMatrix(elem_t* matrix, int rows, int cols);
 
 /**
  * @brief Reads a matrix from a file.
@@ -37,7 +268,18 @@ void printMatrix(int* matrix, int n);
  * @param filename Name of the file to read from.
  * @return 0 if the matrix was successfully read, -1 otherwise.
  */
-int readMatrixFromFile(int* matrix, int n, char* filename);
+int readMatrixFromFile(elem_t* matrix, int n, char* filename);
+
+/**
+ * @brief Reads a rectangular matrix from a file, in any layout, into row-major order.
+ * 
+ * @param matrix Pointer to the matrix.
+ * @param rows Number of rows of the matrix.
+ * @param cols Number of columns of the matrix.
+ * @param filename Name of the file to read from.
+ * @return 0 if the matrix was successfully read, 1 otherwise.
+ */
+int readRectMatrixFromFile(elem_t* matrix, int rows, int cols, char* filename);
 
 /**
  * @brief Writes a matrix to a file.
@@ -47,6 +289,57 @@ int readMatrixFromFile(int* matrix, int n, char* filename);
  * @param filename Name of the file to write to.
  * @return 0 if the matrix was successfully written, -1 otherwise.
  */
-int writeMatrixToFile(int* matrix, int n, char* filename);
+int writeMatrixToFile(elem_t* matrix, int n, char* filename);
+
+/**
+ * @brief Writes a rectangular row-major matrix to a file, in the given layout.
+ * 
+ * @param matrix Pointer to the matrix, in row-major order.
+ * @param rows Number of rows of the matrix.
+ * @param cols Number of columns of the matrix.
+ * @param layout Order of the elements in the file, see MatrixLayout.
+ * @param blockSize Side of the blocks for LAYOUT_BLOCK_MAJOR, must divide rows and cols.
+ * @param filename Name of the file to write to.
+ * @return 0 if the matrix was successfully written, 1 otherwise.
+ */
+int writeRectMatrixToFile(elem_t* matrix, int rows, int cols, int layout, int blockSize, char* filename);
+
+/**
+ * @brief Reorders a matrix so that each block of a q*q grid is contiguous.
+ * 
+ * @param matrix Pointer to the matrix in row-major order.
+ * @param blocks Pointer to the output buffer, blocks are stored in row-major grid order.
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side, blocks are padded with zeros if it does not divide n.
+ */
+void matrixToBlocks(elem_t* matrix, elem_t* blocks, int n, int q);
+
+/**
+ * @brief Inverse of matrixToBlocks, rebuilds a row-major matrix from its blocks.
+ * 
+ * @param blocks Pointer to the blocks, stored in row-major grid order.
+ * @param matrix Pointer to the output matrix.
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side.
+ */
+void blocksToMatrix(elem_t* blocks, elem_t* matrix, int n, int q);
+
+/**
+ * @brief Copies a mapped matrix, in any layout, into row-major order.
+ * 
+ * @param mapped Pointer to the mapped matrix.
+ * @param matrix Pointer to the output matrix.
+ */
+void mappedMatrixToRowMajor(MappedMatrix* mapped, elem_t* matrix);
+
+/**
+ * @brief Copies the blocks of a mapped n*n matrix, in the order produced by matrixToBlocks.
+ * 
+ * @param mapped Pointer to the mapped matrix, in any layout.
+ * @param blocks Pointer to the output buffer.
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side, blocks are padded with zeros if it does not divide n.
+ */
+void mappedMatrixToBlocks(MappedMatrix* mapped, elem_t* blocks, int n, int q);
 
-#endif // INOUTUTILS_H
\ No newline at end of file
+#endif // INOUTUTILS_H
@@ -0,0 +1,74 @@
+/**
+ * @file matrixType.h
+ * @brief Header file selecting the element type of the matrices.
+ *
+ * The type is chosen at compile time by defining one of DTYPE_INT (default), DTYPE_INT64,
+ * DTYPE_FLOAT, DTYPE_DOUBLE or DTYPE_COMPLEX, e.g. with `make DTYPE=DOUBLE`.
+ * Every program and kernel is built on elem_t, so a single build handles a single type.
+ */
+
+#ifndef MATRIXTYPE_H
+#define MATRIXTYPE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @enum ElementType
+ * @brief Codes of the element types, as recorded in the header of the matrix files.
+ */
+enum ElementType{
+    ELEM_INT32 = 1, /**< 32 bit signed integer */
+    ELEM_INT64 = 2, /**< 64 bit signed integer */
+    ELEM_FLOAT = 3, /**< Single precision floating point */
+    ELEM_DOUBLE = 4, /**< Double precision floating point */
+    ELEM_COMPLEX = 5 /**< Double precision complex */
+};
+
+#if defined(DTYPE_INT64)
+typedef int64_t elem_t;
+#define ELEM_TYPE ELEM_INT64
+#define ELEM_NAME "int64"
+#define MPI_ELEM MPI_INT64_T
+#elif defined(DTYPE_FLOAT)
+typedef float elem_t;
+#define ELEM_TYPE ELEM_FLOAT
+#define ELEM_NAME "float"
+#define MPI_ELEM MPI_FLOAT
+#elif defined(DTYPE_DOUBLE)
+typedef double elem_t;
+#define ELEM_TYPE ELEM_DOUBLE
+#define ELEM_NAME "double"
+#define MPI_ELEM MPI_DOUBLE
+#elif defined(DTYPE_COMPLEX)
+#include <complex.h>
+typedef double complex elem_t;
+#define ELEM_TYPE ELEM_COMPLEX
+#define ELEM_NAME "complex"
+#define MPI_ELEM MPI_C_DOUBLE_COMPLEX
+#else
+#ifndef DTYPE_INT
+#define DTYPE_INT
+#endif
+typedef int32_t elem_t;
+#define ELEM_TYPE ELEM_INT32
+#define ELEM_NAME "int"
+#define MPI_ELEM MPI_INT32_T
+#endif
+
+/**
+ * @brief Prints a single element, preceded by a tab.
+ * 
+ * @param value The element to print.
+ */
+static inline void printElement(elem_t value){
+#if defined(DTYPE_COMPLEX)
+    printf("\t%g%+gi", creal(value), cimag(value));
+#elif defined(DTYPE_FLOAT) || defined(DTYPE_DOUBLE)
+    printf("\t%g", (double)value);
+#else
+    printf("\t%lld", (long long)value);
+#endif
+}
+
+#endif // MATRIXTYPE_H
@@ -0,0 +1,226 @@
+/**
+ * @file mpiIOUtils.c
+ * @brief This file contains functions for parallel input/output operations on matrices.
+ *
+ * Every process accesses only its own block of the file through a subarray file view,
+ * so no process has to hold the whole matrix. The views start after the file header.
+ * Row-major, column-major and block-major files (with blocks of the same size as the
+ * process blocks) can be read; results are always written in row-major order.
+ * Blocks are b*b with b = ceil(n/q): when q does not divide n the part of a block beyond
+ * the matrix is zero on input and is skipped on output.
+ */
+
+#include "mpiIOUtils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Number of rows (or columns) of the matrix falling inside a block.
+ * 
+ * @param n The size of the matrix.
+ * @param b The side of the blocks.
+ * @param index The row (or column) of the block in the grid of blocks.
+ * @return The number of rows (or columns) of the block that are not padding.
+ */
+static int blockExtent(int n, int b, int index){
+    return n - index * b < b ? n - index * b : b;
+}
+
+/**
+ * @brief Creates the datatypes selecting some rows of a block of a matrix in the file and in memory.
+ * 
+ * The file view covers the part of the rows inside the matrix, the memory type places
+ * it in the top left corner of a buffer of count*b elements. When none of the rows is
+ * inside the matrix both types are empty.
+ * 
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side of the matrix.
+ * @param row The row of the block in the grid of blocks.
+ * @param col The column of the block in the grid of blocks.
+ * @param first The first row of the block selected.
+ * @param count The number of rows of the block selected.
+ * @param view Pointer to the committed file view.
+ * @param memory Pointer to the committed memory type.
+ * @return The number of selected rows inside the matrix.
+ */
+static int createBlockTypes(int n, int q, int row, int col, int first, int count, MPI_Datatype* view, MPI_Datatype* memory){
+    int b = (n + q - 1) / q;
+    int rows = blockExtent(n, b, row) - first;
+    if(rows > count) rows = count;
+    if(rows <= 0){
+        MPI_Type_contiguous(0, MPI_ELEM, view);
+        MPI_Type_contiguous(0, MPI_ELEM, memory);
+        MPI_Type_commit(view);
+        MPI_Type_commit(memory);
+        return 0;
+    }
+
+    int sizes[2] = {n, n};
+    int subsizes[2] = {rows, blockExtent(n, b, col)};
+    int starts[2] = {row * b + first, col * b};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_ELEM, view);
+    MPI_Type_commit(view);
+
+    int bufferSizes[2] = {count, b};
+    int origin[2] = {0, 0};
+    MPI_Type_create_subarray(2, bufferSizes, subsizes, origin, MPI_ORDER_C, MPI_ELEM, memory);
+    MPI_Type_commit(memory);
+    return rows;
+}
+
+/**
+ * @brief Reads the block of a matrix owned by the calling process.
+ * 
+ * The file is opened collectively, a subarray view restricts each process to its block
+ * and MPI_File_read_all lets the MPI library aggregate the requests.
+ * A column-major file is read as its transpose and the block is transposed back in memory,
+ * a block-major file with blocks of side b is read as one contiguous piece.
+ * The file is rejected if its header does not describe an n*n matrix of elem_t,
+ * if its blocks do not match the process blocks, or if it is too small to hold it.
+ * The checksum is not verified, since no process reads the whole payload.
+ * 
+ * @param block Pointer to the block.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side of the matrix.
+ * @param row The row of the block in the grid of blocks.
+ * @param col The column of the block in the grid of blocks.
+ * @param filename The name of the file to read from.
+ * @param comm The communicator of the processes reading the matrix.
+ * @return 0 if the block was successfully read, 1 otherwise.
+ */
+int readBlockFromFile(elem_t* block, int n, int q, int row, int col, char* filename, MPI_Comm comm){
+    MPI_File file;
+    MPI_Offset size;
+    MPI_Datatype view, memory;
+    MPI_Status status;
+    MatrixFileHeader header;
+    int count;
+    int b = (n + q - 1) / q;
+
+    if(MPI_File_open(comm, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS){
+        return 1;
+    }
+
+    MPI_File_read_at_all(file, 0, &header, sizeof(MatrixFileHeader), MPI_BYTE, &status);
+    MPI_File_get_size(file, &size);
+    if(checkMatrixHeader(&header, n, n) || size < (MPI_Offset)(sizeof(MatrixFileHeader) + (size_t)n * n * sizeof(elem_t)) ||
+       (header.layout == LAYOUT_BLOCK_MAJOR && (header.blockSize != (uint32_t)b || n % q))){
+        MPI_File_close(&file);
+        return 1;
+    }
+
+    if(header.layout == LAYOUT_BLOCK_MAJOR){
+        //The block is already contiguous in the file
+        MPI_Offset offset = sizeof(MatrixFileHeader) + ((MPI_Offset)row * q + col) * b * b * sizeof(elem_t);
+        MPI_File_read_at_all(file, offset, block, b * b, MPI_ELEM, &status);
+        MPI_Get_count(&status, MPI_ELEM, &count);
+        MPI_File_close(&file);
+        return count != b * b;
+    }
+
+    int transposed = header.layout == LAYOUT_COL_MAJOR;
+    if(transposed){
+        createBlockTypes(n, q, col, row, 0, b, &view, &memory);
+    }else{
+        createBlockTypes(n, q, row, col, 0, b, &view, &memory);
+    }
+    if(n % q) memset(block, 0, (size_t)b * b * sizeof(elem_t));
+    MPI_File_set_view(file, sizeof(MatrixFileHeader), MPI_ELEM, view, "native", MPI_INFO_NULL);
+    MPI_File_read_all(file, block, 1, memory, &status);
+    MPI_Get_count(&status, memory, &count);
+
+    if(transposed){
+        for(int i = 0; i < b; i++){
+            for(int j = i + 1; j < b; j++){
+                elem_t tmp = block[i*b + j];
+                block[i*b + j] = block[j*b + i];
+                block[j*b + i] = tmp;
+            }
+        }
+    }
+
+    MPI_Type_free(&view);
+    MPI_Type_free(&memory);
+    MPI_File_close(&file);
+    return count != 1;
+}
+
+/**
+ * @brief Writes the block of a matrix owned by the calling process.
+ * 
+ * The whole block is written as a single slice, see writeBlockRowsToFile.
+ * 
+ * @param block Pointer to the block.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side of the matrix.
+ * @param row The row of the block in the grid of blocks.
+ * @param col The column of the block in the grid of blocks.
+ * @param filename The name of the file to write to.
+ * @param comm The communicator of the processes writing the matrix.
+ * @return 0 if the block was successfully written, 1 otherwise.
+ */
+int writeBlockToFile(elem_t* block, int n, int q, int row, int col, char* filename, MPI_Comm comm){
+    return writeBlockRowsToFile(block, n, q, row, col, 0, (n + q - 1) / q, filename, comm);
+}
+
+/**
+ * @brief Writes some rows of the block of a matrix owned by the calling process.
+ * 
+ * The file is created or truncated to the header plus n*n elements, then every process
+ * writes its rows through a subarray view, with MPI_File_write_all.
+ * Each process checksums its rows at their position in the file, the partial
+ * checksums are summed on the first process of comm, which then writes the header.
+ * When the processes of comm together cover the whole matrix, the resulting file is
+ * identical to the one written by writeMatrixToFile.
+ * 
+ * @param rows Pointer to the rows, count*b elements.
+ * @param n The size of the matrix.
+ * @param q The number of blocks along each side of the matrix.
+ * @param row The row of the block in the grid of blocks.
+ * @param col The column of the block in the grid of blocks.
+ * @param first The first row of the block held in rows.
+ * @param count The number of rows of the block held in rows.
+ * @param filename The name of the file to write to.
+ * @param comm The communicator of the processes writing the matrix.
+ * @return 0 if the rows were successfully written, 1 otherwise.
+ */
+int writeBlockRowsToFile(elem_t* rows, int n, int q, int row, int col, int first, int count, char* filename, MPI_Comm comm){
+    MPI_File file;
+    MPI_Datatype view, memory;
+    MPI_Status status;
+    MatrixFileHeader header;
+    int rank;
+    int written;
+    int b = (n + q - 1) / q;
+    int cols = blockExtent(n, b, col);
+
+    if(MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS){
+        return 1;
+    }
+    MPI_File_set_size(file, (MPI_Offset)(sizeof(MatrixFileHeader) + (size_t)n * n * sizeof(elem_t)));
+
+    int valid = createBlockTypes(n, q, row, col, first, count, &view, &memory);
+    MPI_File_set_view(file, sizeof(MatrixFileHeader), MPI_ELEM, view, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, rows, 1, memory, &status);
+    MPI_Get_count(&status, memory, &written);
+
+    uint64_t checksum = 0;
+    uint64_t wordsPerElem = sizeof(elem_t) / sizeof(uint32_t);
+    for(int i = 0; i < valid; i++){
+        uint64_t firstWord = ((uint64_t)(row * b + first + i) * n + (uint64_t)col * b) * wordsPerElem;
+        checksum += matrixChecksum(rows + i * b, cols * sizeof(elem_t), firstWord);
+    }
+
+    MPI_Comm_rank(comm, &rank);
+    initMatrixHeader(&header, n, n, LAYOUT_ROW_MAJOR, 0);
+    MPI_Reduce(&checksum, &header.checksum, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+    MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL); //Offsets in bytes again
+    if(!rank){
+        MPI_File_write_at(file, 0, &header, sizeof(MatrixFileHeader), MPI_BYTE, &status);
+    }
+
+    MPI_Type_free(&view);
+    MPI_Type_free(&memory);
+    MPI_File_close(&file);
+    return valid && written != 1;
+}
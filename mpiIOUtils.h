@@ -0,0 +1,65 @@
+/**
+ * @file mpiIOUtils.h
+ * @brief Header file containing parallel input/output utility functions based on MPI-IO.
+ */
+
+#ifndef MPIIOUTILS_H
+#define MPIIOUTILS_H
+
+#include "mpi.h"
+#include "inOutUtils.h"
+
+/**
+ * @brief Reads the block of a matrix owned by the calling process.
+ * 
+ * This is a collective operation: every process of comm must call it,
+ * each one with the coordinates of its own block.
+ * 
+ * @param block Pointer to the block, of size b*b with b = ceil(n/q).
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side of the matrix.
+ * @param row Row of the block in the grid of blocks.
+ * @param col Column of the block in the grid of blocks.
+ * @param filename Name of the file to read from.
+ * @param comm Communicator of the processes reading the matrix.
+ * @return 0 if the block was successfully read, 1 otherwise.
+ */
+int readBlockFromFile(elem_t* block, int n, int q, int row, int col, char* filename, MPI_Comm comm);
+
+/**
+ * @brief Writes the block of a matrix owned by the calling process.
+ * 
+ * This is a collective operation: every process of comm must call it,
+ * each one with the coordinates of its own block.
+ * 
+ * @param block Pointer to the block, of size b*b with b = ceil(n/q).
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side of the matrix.
+ * @param row Row of the block in the grid of blocks.
+ * @param col Column of the block in the grid of blocks.
+ * @param filename Name of the file to write to.
+ * @param comm Communicator of the processes writing the matrix.
+ * @return 0 if the block was successfully written, 1 otherwise.
+ */
+int writeBlockToFile(elem_t* block, int n, int q, int row, int col, char* filename, MPI_Comm comm);
+
+/**
+ * @brief Writes some rows of the block of a matrix owned by the calling process.
+ * 
+ * This is a collective operation: every process of comm must call it, each one with
+ * its own block and rows. Together the processes must cover the whole matrix.
+ * 
+ * @param rows Pointer to the rows, count*b elements with b = ceil(n/q).
+ * @param n Size of the matrix.
+ * @param q Number of blocks along each side of the matrix.
+ * @param row Row of the block in the grid of blocks.
+ * @param col Column of the block in the grid of blocks.
+ * @param first First row of the block held in rows.
+ * @param count Number of rows of the block held in rows.
+ * @param filename Name of the file to write to.
+ * @param comm Communicator of the processes writing the matrix.
+ * @return 0 if the rows were successfully written, 1 otherwise.
+ */
+int writeBlockRowsToFile(elem_t* rows, int n, int q, int row, int col, int first, int count, char* filename, MPI_Comm comm);
+
+#endif // MPIIOUTILS_H
@@ -0,0 +1,144 @@
+/**
+ * @file phaseProfiler.c
+ * @brief This file contains the per-phase timers and traffic counters of the DNS variant.
+ *
+ * Every process accumulates the wall time, the number of calls and the bytes moved by
+ * each phase. The counters are plain arrays, so timing a phase costs two calls to MPI_Wtime
+ * and the report needs only three reductions.
+ */
+
+#include "phaseProfiler.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @struct PhaseInfo
+ * @brief Names used in the report for a phase.
+ */
+typedef struct {
+    const char* name; /**< Name of the phase */
+    const char* communicator; /**< Communicator carrying its traffic */
+} PhaseInfo;
+
+static const PhaseInfo phaseInfo[PHASE_COUNT] = {
+    {"read", "file"},
+    {"scatter", "commXYplanes"},
+    {"bcast_a_z", "commZsingleDim"},
+    {"bcast_b_z", "commZsingleDim"},
+    {"bcast_a_x", "commSubMatrixX"},
+    {"bcast_b_y", "commSubMatrixY"},
+    {"align", "commXYplanes"},
+    {"fused", "commGraph"},
+    {"shift", "commXYplanes"},
+    {"panel_a", "commXsingleDim"},
+    {"panel_b", "commYsingleDim"},
+    {"compute", "none"},
+    {"reduce", "commZsingleDim"},
+    {"gather", "commXYplanes"},
+    {"write", "file"}
+};
+
+static double phaseStart[PHASE_COUNT]; /**< Start time of the running interval of each phase */
+static double phaseTime[PHASE_COUNT]; /**< Accumulated wall time of each phase */
+static double phaseCalls[PHASE_COUNT]; /**< Number of intervals of each phase */
+static double phaseBytes[PHASE_COUNT]; /**< Bytes moved by each phase */
+
+/**
+ * @brief Starts the timer of a phase on the calling process.
+ * 
+ * @param phase The phase to time.
+ */
+void phaseBegin(enum Phase phase){
+    phaseStart[phase] = MPI_Wtime();
+}
+
+/**
+ * @brief Stops the timer of a phase and adds the bytes it moved.
+ * 
+ * @param phase The phase being timed.
+ * @param bytes The bytes sent or received by the calling process in this call.
+ */
+void phaseEnd(enum Phase phase, double bytes){
+    phaseTime[phase] += MPI_Wtime() - phaseStart[phase];
+    phaseCalls[phase] += 1;
+    phaseBytes[phase] += bytes;
+}
+
+/**
+ * @brief Collects the counters of all the processes and writes the report.
+ * 
+ * Times and bytes are reduced with MPI_MIN, MPI_MAX and MPI_SUM in a single buffer, the
+ * averages are taken over all the processes of comm, including those that never entered
+ * a phase. A large gap between maximum and average points at the phase that limits scaling.
+ * 
+ * @param comm The communicator of the processes taking part in the product.
+ * @param filename The name of the report file.
+ * @return 0 if the report was written, 1 otherwise.
+ */
+int writePhaseReport(MPI_Comm comm, const char* filename){
+    double local[3*PHASE_COUNT], minimum[3*PHASE_COUNT], maximum[3*PHASE_COUNT], sum[3*PHASE_COUNT];
+    int rank, size;
+
+    memcpy(local, phaseTime, sizeof(phaseTime));
+    memcpy(local + PHASE_COUNT, phaseCalls, sizeof(phaseCalls));
+    memcpy(local + 2*PHASE_COUNT, phaseBytes, sizeof(phaseBytes));
+    MPI_Reduce(local, minimum, 3*PHASE_COUNT, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local, maximum, 3*PHASE_COUNT, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(local, sum, 3*PHASE_COUNT, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if(rank) return 0;
+
+    FILE* file = fopen(filename, "w");
+    if(file == NULL){
+        return 1;
+    }
+
+    size_t length = strlen(filename);
+    int json = length >= 5 && !strcmp(filename + length - 5, ".json");
+    double* bytes = sum + 2*PHASE_COUNT;
+
+    if(json){
+        fprintf(file, "{\n  \"processes\": %d,\n  \"phases\": [\n", size);
+    }else{
+        fprintf(file, "phase;communicator;calls;time_min;time_max;time_avg;bytes_min;bytes_max;bytes_avg\n");
+    }
+    for(int i = 0; i < PHASE_COUNT; i++){
+        int t = i, c = PHASE_COUNT + i, b = 2*PHASE_COUNT + i;
+        if(json){
+            fprintf(file, "    {\"phase\": \"%s\", \"communicator\": \"%s\", \"calls\": %.0f, "
+                          "\"time\": {\"min\": %.9f, \"max\": %.9f, \"avg\": %.9f}, "
+                          "\"bytes\": {\"min\": %.0f, \"max\": %.0f, \"avg\": %.1f}}%s\n",
+                    phaseInfo[i].name, phaseInfo[i].communicator, maximum[c],
+                    minimum[t], maximum[t], sum[t] / size,
+                    minimum[b], maximum[b], sum[b] / size, i < PHASE_COUNT - 1 ? "," : "");
+        }else{
+            fprintf(file, "%s;%s;%.0f;%.9f;%.9f;%.9f;%.0f;%.0f;%.1f\n",
+                    phaseInfo[i].name, phaseInfo[i].communicator, maximum[c],
+                    minimum[t], maximum[t], sum[t] / size,
+                    minimum[b], maximum[b], sum[b] / size);
+        }
+    }
+
+    if(json){
+        //Total traffic of every communicator, summed over the phases using it
+        fprintf(file, "  ],\n  \"communicators\": {");
+        int first = 1;
+        for(int i = 0; i < PHASE_COUNT; i++){
+            int seen = 0;
+            for(int j = 0; j < i; j++) seen |= !strcmp(phaseInfo[i].communicator, phaseInfo[j].communicator);
+            if(seen) continue;
+            double total = 0;
+            for(int j = i; j < PHASE_COUNT; j++){
+                if(!strcmp(phaseInfo[i].communicator, phaseInfo[j].communicator)) total += bytes[j];
+            }
+            fprintf(file, "%s\"%s\": %.0f", first ? "" : ", ", phaseInfo[i].communicator, total);
+            first = 0;
+        }
+        fprintf(file, "}\n}\n");
+    }
+
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file phaseProfiler.h
+ * @brief Header file containing the per-phase timers and traffic counters of the DNS variant.
+ */
+
+#ifndef PHASEPROFILER_H
+#define PHASEPROFILER_H
+
+#include "mpi.h"
+
+/**
+ * @enum Phase
+ * @brief Phases of a distributed product, each one with its own timer and byte counter.
+ */
+enum Phase{
+    PHASE_READ, /**< Reading the input files */
+    PHASE_SCATTER, /**< Scattering the blocks along layer 0 */
+    PHASE_BCAST_A_Z, /**< Broadcast of A along Z */
+    PHASE_BCAST_B_Z, /**< Broadcast of B along Z */
+    PHASE_BCAST_A_X, /**< Broadcast of A inside the layers */
+    PHASE_BCAST_B_Y, /**< Broadcast of B inside the layers */
+    PHASE_ALIGN, /**< Initial Cannon alignment */
+    PHASE_FUSED, /**< Fused distribution replacing broadcasts and alignment */
+    PHASE_SHIFT, /**< Cannon shifts, one call per step */
+    PHASE_PANEL_A, /**< SUMMA broadcasts of the panels of A along the grid rows */
+    PHASE_PANEL_B, /**< SUMMA broadcasts of the panels of B along the grid columns */
+    PHASE_COMPUTE, /**< Local multiplications, one call per step */
+    PHASE_REDUCE, /**< Reduction of C along Z */
+    PHASE_GATHER, /**< Gathering C on process 0 */
+    PHASE_WRITE, /**< Writing the result file */
+    PHASE_COUNT /**< Number of phases */
+};
+
+/**
+ * @brief Starts the timer of a phase on the calling process.
+ * 
+ * @param phase Phase to time.
+ */
+void phaseBegin(enum Phase phase);
+
+/**
+ * @brief Stops the timer of a phase and adds the bytes it moved.
+ * 
+ * @param phase Phase being timed.
+ * @param bytes Bytes sent or received by the calling process in this call.
+ */
+void phaseEnd(enum Phase phase, double bytes);
+
+/**
+ * @brief Collects the counters of all the processes and writes the report.
+ * 
+ * This is a collective operation over comm. Process 0 of comm writes the minimum,
+ * maximum and average of every counter, as JSON if the file name ends in ".json"
+ * and as CSV otherwise.
+ * 
+ * @param comm Communicator of the processes taking part in the product.
+ * @param filename Name of the report file.
+ * @return 0 if the report was written, 1 otherwise.
+ */
+int writePhaseReport(MPI_Comm comm, const char* filename);
+
+#endif // PHASEPROFILER_H
@@ -10,28 +10,45 @@
 /**
  * @brief The main function to print a matrix from a file.
  * 
+ * The size of the matrix is read from the header of the file. If it is also given
+ * on the command line, the file must describe a square matrix of that size.
+ * 
  * @param argc The number of command-line arguments.
  * @param argv An array of strings containing the command-line arguments.
- *             The first argument should be the size of the matrix, and the second argument should be the filename.
+ *             The optional first argument is the size of the matrix, the last argument is the filename.
  * 
  * @return 0 if the program executed successfully, 1 otherwise.
  */
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <size> <filename>\n", argv[0]);
+    static const char* layouts[] = {"row-major", "col-major", "block-major"};
+    MatrixFileHeader header;
+
+    if (argc != 2 && argc != 3) {
+        printf("Usage: %s [size] <filename>\n", argv[0]);
+        return 1;
+    }
+
+    char *filename = argv[argc - 1];
+    if(readMatrixInfo(&header, filename)) {
+        printf("Error reading matrix from file\n");
         return 1;
     }
 
-    int size = atoi(argv[1]);
-    char *filename = argv[2];
+    int rows = header.rows;
+    int cols = header.cols;
+    if(argc == 3 && (rows != atoi(argv[1]) || cols != rows)) {
+        printf("Error: %s is a %d*%d matrix\n", filename, rows, cols);
+        return 1;
+    }
 
-    int* matrix = malloc(size * size * sizeof(int));
-    if(readMatrixFromFile(matrix, size, filename)) {
+    elem_t* matrix = malloc((size_t)rows * cols * sizeof(elem_t));
+    if(matrix == NULL || readRectMatrixFromFile(matrix, rows, cols, filename)) {
         printf("Error reading matrix from file\n");
         return 1;
     }
-    printf("Filename %s - Size %d*%d:\n", filename, size, size);
-    printMatrix(matrix, size);
+    printf("Filename %s - Size %d*%d - Type %s - Layout %s:\n", filename, rows, cols, ELEM_NAME, layouts[header.layout]);
+    printRectMatrix(matrix, rows, cols);
 
+    free(matrix);
     return 0;
-}
\ No newline at end of file
+}
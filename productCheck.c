@@ -0,0 +1,169 @@
+/**
+ * @file productCheck.c
+ * @brief This file contains the distributed verification of a product (Freivalds test).
+ *
+ * Instead of recomputing C, the test multiplies both sides of C = A * B by a random n*k
+ * matrix X (k = VERIFY_VECTORS) and compares A * (B * X) with C * X, which costs O(n*n*k).
+ * A wrong C passes the test only if the random vectors happen to be orthogonal to every
+ * wrong row, so the probability of missing an error shrinks with the range of the entries
+ * and with the number of vectors.
+ *
+ * The work is spread on layer 0, where process (y,x) owns A(y,x), B(y,x) and C(y,x):
+ * (B * X)_y is summed along row y onto the diagonal process (y,y), which broadcasts it
+ * along column y; then every process computes A(y,x) * (B * X)_x - C(y,x) * X_x and the
+ * differences are summed along the rows.
+ *
+ * Integer sums wrap around in the same way on both sides, so integer types must match
+ * exactly; floating point types are compared with a tolerance relative to the norms.
+ */
+
+#include "productCheck.h"
+#include "gemmKernel.h"
+#include "mpi.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(DTYPE_FLOAT)
+#define VERIFY_EPSILON FLT_EPSILON /**< Machine epsilon of the element type */
+#elif defined(DTYPE_DOUBLE) || defined(DTYPE_COMPLEX)
+#define VERIFY_EPSILON DBL_EPSILON /**< Machine epsilon of the element type */
+#endif
+
+/**
+ * @brief Scrambles a 64 bit counter (finalizer of splitmix64).
+ *
+ * @param value The counter to scramble.
+ * @return The scrambled bits.
+ */
+static unsigned long long mixBits(unsigned long long value){
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+/**
+ * @brief Returns an entry of the random matrix X.
+ *
+ * Every entry depends only on the seed and on its position, so each process can build its
+ * own rows without communication.
+ *
+ * @param seed The seed shared by the processes.
+ * @param index The position of the entry in X.
+ * @return The entry, in [0,1) for floating point types and in 0 ... 1023 for integer types.
+ */
+static elem_t randomEntry(unsigned long long seed, unsigned long long index){
+    unsigned long long bits = mixBits(seed ^ mixBits(index));
+#ifdef VERIFY_EPSILON
+    return (elem_t)((bits >> 11) * 0x1.0p-53);
+#else
+    return (elem_t)(bits % 1024);
+#endif
+}
+
+#ifdef VERIFY_EPSILON
+/**
+ * @brief Returns the squared magnitude of an element.
+ *
+ * @param value The element.
+ * @return The squared magnitude.
+ */
+static double squaredMagnitude(elem_t value){
+#if defined(DTYPE_COMPLEX)
+    return creal(value)*creal(value) + cimag(value)*cimag(value);
+#else
+    return (double)value * (double)value;
+#endif
+}
+#endif
+
+/**
+ * @brief Checks C = A * B with the Freivalds test, comparing A * (B * X) with C * X for random X.
+ *
+ * Proc 0 draws a new seed at every call and shares it with layer 0. The padding of the
+ * blocks is zero in A, B and C, so it does not change the differences.
+ *
+ * @param ctx The pointer to the context of the grid.
+ * @param blockA The block of A of the process.
+ * @param blockB The block of B of the process.
+ * @param blockC The block of C of the process.
+ * @param residual The pointer receiving the residual.
+ * @return 0 if the product passed the test, 1 otherwise.
+ */
+int verifyProduct(DnsContext* ctx, elem_t* blockA, elem_t* blockB, elem_t* blockC, double* residual){
+    static unsigned long long calls = 0; /**< Products checked so far, mixed into the seed */
+    int b = ctx->b;
+    int x = ctx->coords[X];
+    int y = ctx->coords[Y];
+    int failed;
+    size_t size = (size_t)b*VERIFY_VECTORS;
+    unsigned long long seed = 0;
+    MPI_Comm commRow = ctx->comms.commXsingleDim; //Rank x in row y
+    MPI_Comm commColumn = ctx->comms.commYsingleDim; //Rank y in column x
+
+    elem_t* vectors = malloc(size*sizeof(elem_t)); /**< Rows x*b ... x*b + b - 1 of X */
+    elem_t* product = malloc(size*sizeof(elem_t)); /**< Rows of B * X matching the columns of the block */
+    elem_t* left = calloc(size, sizeof(elem_t)); /**< A(y,x) * (B * X)_x, then the difference */
+    elem_t* right = calloc(size, sizeof(elem_t)); /**< C(y,x) * X_x */
+    if(vectors==NULL || product==NULL || left==NULL || right==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+
+    if(!ctx->cartRank) seed = mixBits((unsigned long long)time(NULL)) ^ calls;
+    calls++;
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG_LONG, 0, ctx->comms.commXYplanes);
+
+    for(size_t i = 0; i < size; i++){
+        vectors[i] = randomEntry(seed, (unsigned long long)x*size + i);
+    }
+
+    //(B * X)_y = sum over x of B(y,x) * X_x, collected on (y,y) and spread along column y
+    gemmKernel(blockB, vectors, right, b, VERIFY_VECTORS, b, b, VERIFY_VECTORS, VERIFY_VECTORS);
+    MPI_Reduce(right, product, size, MPI_ELEM, MPI_SUM, y, commRow);
+    MPI_Bcast(product, size, MPI_ELEM, x, commColumn);
+
+    memset(right, 0, size*sizeof(elem_t));
+    gemmKernel(blockA, product, left, b, VERIFY_VECTORS, b, b, VERIFY_VECTORS, VERIFY_VECTORS);
+    gemmKernel(blockC, vectors, right, b, VERIFY_VECTORS, b, b, VERIFY_VECTORS, VERIFY_VECTORS);
+    for(size_t i = 0; i < size; i++) left[i] -= right[i];
+    MPI_Allreduce(MPI_IN_PLACE, left, size, MPI_ELEM, MPI_SUM, commRow);
+
+#ifdef VERIFY_EPSILON
+    double norms[4] = {0, 0, 0, 0}; /**< Squared norms of the difference, A, B and X */
+    for(size_t i = 0; i < size; i++){
+        if(x == 0) norms[0] += squaredMagnitude(left[i]);
+        if(y == 0) norms[3] += squaredMagnitude(vectors[i]);
+    }
+    for(size_t i = 0; i < (size_t)b*b; i++){
+        norms[1] += squaredMagnitude(blockA[i]);
+        norms[2] += squaredMagnitude(blockB[i]);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, norms, 4, MPI_DOUBLE, MPI_SUM, ctx->comms.commXYplanes);
+
+    double scale = sqrt(norms[1]) * sqrt(norms[2]) * sqrt(norms[3]);
+    *residual = scale > 0 ? sqrt(norms[0]) / scale : sqrt(norms[0]);
+    failed = !(*residual <= VERIFY_TOLERANCE * ctx->n * VERIFY_EPSILON);
+#else
+    double largest = 0;
+    if(x == 0){
+        for(size_t i = 0; i < size; i++){
+            double difference = fabs((double)left[i]);
+            if(difference > largest) largest = difference;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &largest, 1, MPI_DOUBLE, MPI_MAX, ctx->comms.commXYplanes);
+
+    *residual = largest;
+    failed = largest != 0;
+#endif
+
+    free(vectors);
+    free(product);
+    free(left);
+    free(right);
+    return failed;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file productCheck.h
+ * @brief Header file containing the distributed verification of a product (Freivalds test).
+ */
+
+#ifndef PRODUCTCHECK_H
+#define PRODUCTCHECK_H
+
+#include "matrixType.h"
+#include "dnsEngine.h"
+
+/**
+ * @def VERIFY_VECTORS
+ * @brief Number of random vectors tested together.
+ */
+#define VERIFY_VECTORS 4
+
+/**
+ * @def VERIFY_TOLERANCE
+ * @brief Multiple of n times the machine epsilon accepted as relative residual for floating point types.
+ */
+#define VERIFY_TOLERANCE 16.0
+
+/**
+ * @brief Checks C = A * B with the Freivalds test, comparing A * (B * X) with C * X for random X.
+ *
+ * This is a collective operation over the processes of layer 0, each one passing its own
+ * blocks A(y,x), B(y,x) and C(y,x) as they are after the input. The work is O(b*b) per process.
+ *
+ * @param ctx Pointer to the context of the grid.
+ * @param blockA Block of A of the process.
+ * @param blockB Block of B of the process.
+ * @param blockC Block of C of the process.
+ * @param residual Pointer receiving the residual: the largest difference for integer types,
+ *                 the relative Frobenius norm of the difference for floating point types.
+ * @return 0 if the product passed the test, 1 otherwise.
+ */
+int verifyProduct(DnsContext* ctx, elem_t* blockA, elem_t* blockB, elem_t* blockC, double* residual);
+
+#endif // PRODUCTCHECK_H
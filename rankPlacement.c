@@ -0,0 +1,159 @@
+/**
+ * @file rankPlacement.c
+ * @brief This file contains the topology-aware placement of the process grid.
+ *
+ * The grid is built with reorder = 0, so by default the cells follow the launch order of
+ * the ranks and the Cannon shifts or the Z broadcasts often cross nodes. The topology
+ * placement sorts the processes by node and socket and gives them the cells in brick
+ * order: a brick is one s*s submatrix (s = q/m) in all the m layers, so it holds whole
+ * shift rings and whole Z columns, and consecutive processes of a node fill it layer
+ * after layer.
+ *
+ * The nodes come from MPI_Comm_split_type; the sockets come from hwloc when the program is
+ * compiled with HAVE_HWLOC, otherwise all the processes of a node count as one socket.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rankPlacement.h"
+#ifdef HAVE_HWLOC
+#include <hwloc.h>
+#endif
+
+/**
+ * @brief Returns the socket the calling process is bound to.
+ *
+ * @return The logical index of the socket, 0 if it is unknown or the process is not bound to one.
+ */
+static int socketIndex(void){
+    int socket = 0;
+#ifdef HAVE_HWLOC
+    hwloc_topology_t topology;
+    hwloc_bitmap_t set = hwloc_bitmap_alloc();
+    hwloc_topology_init(&topology);
+    if(set != NULL && !hwloc_topology_load(topology) && !hwloc_get_cpubind(topology, set, HWLOC_CPUBIND_PROCESS)){
+        hwloc_obj_t object = hwloc_get_obj_covering_cpuset(topology, set);
+        if(object != NULL && object->type != HWLOC_OBJ_PACKAGE){
+            object = hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_PACKAGE, object);
+        }
+        if(object != NULL) socket = object->logical_index;
+    }
+    hwloc_bitmap_free(set);
+    hwloc_topology_destroy(topology);
+#endif
+    return socket;
+}
+
+/**
+ * @brief Returns the communicator whose rank order lays the grid onto the processes.
+ *
+ * With the topology placement every process finds its position in the processes sorted
+ * by node, socket and rank, and takes the cell at the same position in brick order.
+ * The bricks are numbered row by row, inside a brick the cells go layer by layer and
+ * row by row, so a node with s*s processes holds whole submatrices of a layer and a node
+ * with s*s*m processes whole bricks.
+ *
+ * @param parent The communicator of the processes taking part in the grid.
+ * @param q The side of each layer of the grid.
+ * @param m The number of layers of the grid.
+ * @param placement The strategy used to lay the grid.
+ * @return A new communicator with the processes of parent.
+ */
+MPI_Comm placeGrid(MPI_Comm parent, int q, int m, enum Placement placement){
+    MPI_Comm placed;
+    MPI_Comm commNode;
+    int rank, size;
+    int location[2]; /**< Node and socket of the process */
+    MPI_Comm_rank(parent, &rank);
+    MPI_Comm_size(parent, &size);
+
+    if(placement == PLACEMENT_LAUNCH){
+        MPI_Comm_dup(parent, &placed);
+        return placed;
+    }
+
+    //The node is named after the rank of its first process
+    MPI_Comm_split_type(parent, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &commNode);
+    location[0] = rank;
+    MPI_Bcast(&location[0], 1, MPI_INT, 0, commNode);
+    MPI_Comm_free(&commNode);
+    location[1] = socketIndex();
+
+    int* locations = malloc(2*size*sizeof(int));
+    if(locations==NULL){
+        printf("Abort... error allocating memory.\n");
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+    MPI_Allgather(location, 2, MPI_INT, locations, 2, MPI_INT, parent);
+
+    int position = 0;
+    for(int i = 0; i < size; i++){
+        int before = locations[2*i] < location[0] ||
+                     (locations[2*i] == location[0] && locations[2*i+1] < location[1]) ||
+                     (locations[2*i] == location[0] && locations[2*i+1] == location[1] && i < rank);
+        position += before;
+    }
+    free(locations);
+
+    int s = q / m;
+    int brick = position / (s*s*m);
+    int cell = position % (s*s*m);
+    int z = cell / (s*s);
+    int y = brick / m * s + cell % (s*s) / s;
+    int x = brick % m * s + cell % s;
+    MPI_Comm_split(parent, 0, (z*q + y)*q + x, &placed);
+    return placed;
+}
+
+/**
+ * @brief Reports on stderr how much of the traffic of a product stays within a node.
+ *
+ * The traffic is estimated from the schedule of the cannon engine: every process sends
+ * s - 1 blocks of A to its right and s - 1 blocks of B below it inside its submatrix,
+ * and every process outside layer 0 receives A and B from its Z column and sends back
+ * its partial C. A transfer stays within a node if both ends share the memory.
+ *
+ * @param ctx The pointer to the context of the grid.
+ */
+void reportPlacement(DnsContext* ctx){
+    MPI_Comm commCart = ctx->comms.commCart;
+    MPI_Comm commNode;
+    MPI_Group groupCart, groupNode;
+    AdjacentCells adj;
+    int q = ctx->q;
+    int s = q / ctx->m;
+    int planeRank, nodeRank;
+    int partners[3]; /**< Right and lower neighbour, process of layer 0 of the Z column */
+    int translated[3];
+    double traffic[5] = {0, 0, 0, 0, 0}; /**< Shifts inside the node, all the shifts, Z inside the node, all the Z, nodes */
+
+    MPI_Comm_split_type(commCart, MPI_COMM_TYPE_SHARED, ctx->cartRank, MPI_INFO_NULL, &commNode);
+    MPI_Comm_rank(commNode, &nodeRank);
+    MPI_Comm_rank(ctx->comms.commXYplanes, &planeRank);
+    findAdjacentCells(planeRank, q, ctx->m, 1, 1, &adj);
+    partners[0] = ctx->coords[Z]*q*q + adj.right;
+    partners[1] = ctx->coords[Z]*q*q + adj.down;
+    partners[2] = ctx->coords[Y]*q + ctx->coords[X];
+    MPI_Comm_group(commCart, &groupCart);
+    MPI_Comm_group(commNode, &groupNode);
+    MPI_Group_translate_ranks(groupCart, 3, partners, groupNode, translated);
+    MPI_Group_free(&groupCart);
+    MPI_Group_free(&groupNode);
+    MPI_Comm_free(&commNode);
+
+    if(s > 1){
+        traffic[0] = (s - 1)*((translated[0] != MPI_UNDEFINED) + (translated[1] != MPI_UNDEFINED));
+        traffic[1] = 2*(s - 1);
+    }
+    if(ctx->coords[Z] != 0){
+        traffic[2] = 3*(translated[2] != MPI_UNDEFINED);
+        traffic[3] = 3;
+    }
+    traffic[4] = !nodeRank;
+
+    MPI_Reduce(ctx->cartRank ? traffic : MPI_IN_PLACE, traffic, 5, MPI_DOUBLE, MPI_SUM, 0, commCart);
+    if(!ctx->cartRank){
+        fprintf(stderr, "Traffico interno ai nodi (%.0f nodi): spostamenti %.1f%%, colonne Z %.1f%%\n", traffic[4],
+                traffic[1] > 0 ? 100*traffic[0]/traffic[1] : 100.0, traffic[3] > 0 ? 100*traffic[2]/traffic[3] : 100.0);
+    }
+}
@@ -0,0 +1,45 @@
+/**
+ * @file rankPlacement.h
+ * @brief Header file containing the topology-aware placement of the process grid.
+ */
+
+#ifndef RANKPLACEMENT_H
+#define RANKPLACEMENT_H
+
+#include "mpi.h"
+#include "dnsEngine.h"
+
+/**
+ * @enum Placement
+ * @brief Ways of laying the q*q*m grid onto the processes.
+ */
+enum Placement{
+    PLACEMENT_LAUNCH, /**< Grid cells in the order of the ranks, as started by mpirun */
+    PLACEMENT_TOPOLOGY /**< Grid cells grouped by node and socket, one brick of submatrices at a time */
+};
+
+/**
+ * @brief Returns the communicator whose rank order lays the grid onto the processes.
+ *
+ * This is a collective operation over parent, which must have exactly q*q*m processes.
+ * The grid built on the returned communicator gives the process of rank r the cell of
+ * Cartesian rank r.
+ *
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param q Side of each layer of the grid.
+ * @param m Number of layers of the grid.
+ * @param placement Strategy used to lay the grid.
+ * @return A new communicator with the processes of parent, to be freed by the caller.
+ */
+MPI_Comm placeGrid(MPI_Comm parent, int q, int m, enum Placement placement);
+
+/**
+ * @brief Reports on stderr how much of the traffic of a product stays within a node.
+ *
+ * This is a collective operation over the grid; proc 0 of the grid prints the report.
+ *
+ * @param ctx Pointer to the context of the grid.
+ */
+void reportPlacement(DnsContext* ctx);
+
+#endif // RANKPLACEMENT_H
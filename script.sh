@@ -4,6 +4,9 @@ export LC_NUMERIC="C"
 MAX_RUNS=50
 M_FLAG=0
 C_FLAG=0
+V_FLAG=0
+S_FLAG=0
+MPIRUN_OPTS="--oversubscribe"
 
 usage() {
     local script_name=$1
@@ -12,13 +15,13 @@ usage() {
     echo "    $script_name - Utility script for measuring the performance and correctness check."
     echo
     echo "SYNOPSIS"
-    echo "    $script_name [-b] [-d] [-n SIZE -m | -n SIZE -c -p PROC]"
+    echo "    $script_name [-b] [-d] [-t THREADS] [-n SIZE -m [-p PROC] | -n SIZE -c -p PROC | -n SIZE -v -p PROC | -n SIZE -s -p PROC]"
     echo
     echo "DESCRIPTION"
     echo "    $script_name can be used to build the project, clean the project, measure the performance of the dnsVariant algorithm,"
     echo "    and check the correctness."
     echo "    Options -b and -d must be used alone."
-    echo "    Options -n and -m or -n, -c and -p must be used together."
+    echo "    Options -n and -m, -n, -c and -p, -n, -v and -p or -n, -s and -p must be used together."
     echo
     echo "OPTIONS"
     echo "    -b"
@@ -27,13 +30,20 @@ usage() {
     echo "    -d"
     echo "        Clean the compiled files, input files and output files. It must be used alone."
     echo
+    echo "    -t THREADS"
+    echo "        Hybrid mode: every MPI process runs the local multiplications with THREADS OpenMP threads"
+    echo "        and is bound to THREADS cores, instead of oversubscribing one process per core."
+    echo
     echo "    -n SIZE"
     echo "        Specifies the size of the matrix. This argument is mandatory when using the -m or -c option."
     echo
     echo "    -m"
-    echo "        Runs the algorithm MAX_RUNS times and saves the measurements in a CSV file inside the measurements folder."
+    echo "        Runs benchDns in a single MPI job: after a warm-up, the sequential kernel and every grid that fits"
+    echo "        in PROC processes (default SIZE^3) run MAX_RUNS times and the median times are saved in a CSV file"
+    echo "        inside the measurements folder, next to a BENCH_ file with percentiles, GFLOP/s and speedup."
     echo "        It requires the -n option. The -c option is not allowed."
-    echo "        The CSV file will contain the following columns: Processor number, Input Time, Computation Time."
+    echo "        The CSV file will contain the following columns: Processor number, Input Time, Computation Time,"
+    echo "        with one row per processor number: the sequential kernel for 1 and the fastest grid for the others."
     echo
     echo "    -c"
     echo "        It check the correctness of the dnsVariant algorithm. It requires the -n and -p options."
@@ -41,9 +51,20 @@ usage() {
     echo "        It requires the existence of matrixA.bin and matrixB.bin files. Those can be generate with"
     echo "        the command ./generateMatrix [SIZE]."
     echo
+    echo "    -v"
+    echo "        It checks the correctness inside the dnsVariant job with the Freivalds test, without the sequential"
+    echo "        run and without comparing files, so it also works for large sizes and floating point types."
+    echo "        It requires the -n and -p options and generates the input matrices."
+    echo
+    echo "    -s"
+    echo "        It checks the server mode of dnsVariant through socat: rejected requests must be answered with ERR"
+    echo "        and must not be computed, and quit must stop the server even right after a rejected request."
+    echo "        It requires the -n and -p options and generates the input matrices."
+    echo
     echo "    -p PROC"
-    echo "        Specifies the number of processes. It must be a multiple of SIZE^2, comprised between SIZE^2 and SIZE^3."
-    echo "        This argument is mandatory when using the -c option."
+    echo "        Specifies the number of processes. Any positive number works: dnsVariant picks the largest grid that fits"
+    echo "        and leaves the remaining processes idle."
+    echo "        This argument is mandatory when using the -c option; with -m it bounds the grids measured."
     echo
     echo "EXAMPLES"
     echo
@@ -59,6 +80,12 @@ usage() {
     echo "        $script_name -n 6 -c -p 72"
     echo "            Check the correctness of the dnsVariant algorithm with matrix size 6 and 72 processes."
     echo
+    echo "        $script_name -n 600 -v -p 72"
+    echo "            Check in the job the product of two 600*600 matrices with 72 processes."
+    echo
+    echo "        $script_name -n 12 -s -p 8"
+    echo "            Check the server mode with matrix size 12 and 8 processes."
+    echo
     echo "AUTHOR"
     echo "    Cezar Narcis Culcea"
     exit 1
@@ -83,62 +110,14 @@ generateInput(){
 }
 
 measure(){
-    timestamp=$(date +%d%m%Y_%H%M)
-    csv_file="./measurements/SIZE${SIZE}_${timestamp}.csv"
-    echo "Measurements matrix SIZE $SIZE * $SIZE" >> $csv_file
-    echo "Proc;Input Time;Calc Time" >> $csv_file
-
-    #################### Sequential Measurements ###################
-    echo "-------------------------------------------------------------------------------------------------------"
-    echo "Sequential Algorithm Measurements (Avg. on $MAX_RUNS runs)"
-    inputTime_seq=0
-    calcTime_seq=0
-
-    for i in $(seq 1 $MAX_RUNS); do
-        output=$(./seqMatrixMultiply $SIZE)
-        time1=$(echo $output | awk '{print $1}')
-        time2=$(echo $output | awk '{print $2}')
-
-        inputTime_seq=$(echo "$inputTime_seq + $time1" | bc -l)
-        calcTime_seq=$(echo "$calcTime_seq + $time2" | bc -l)
-
-    done
-
-    inputTime_seq=$(echo "$inputTime_seq / $MAX_RUNS" | bc -l)
-    calcTime_seq=$(echo "$calcTime_seq / $MAX_RUNS" | bc -l)
-    printf "\tInput Time: %10.6f  -  Calc Time: %10.6f\n" $inputTime_seq $calcTime_seq
-
-    printf "%d;%10.6f;%10.6f\n" 1 $inputTime_seq $calcTime_seq >> $csv_file
+    mkdir -p ./measurements
+    if [[ -z $PROC ]]; then
+        PROC=$((SIZE*SIZE*SIZE))
+    fi
 
-    #################### Parallel Measurements ###################  
     echo "-------------------------------------------------------------------------------------------------------"
-    echo "Parallel Algorithm Measurements (Avg. on $MAX_RUNS runs)"
-
-    for i in $(seq 1 $SIZE); do
-        if (( SIZE % i == 0 )); then
-            proc=$((SIZE*SIZE*i))
-            inputTime_par=0
-            calTime_par=0
-
-            printf "\tProcs number: %d = %d*%d*%d\t--> " $proc $SIZE $SIZE $i 
-
-            for j in $(seq 1 $MAX_RUNS); do
-                output=$(mpirun --oversubscribe -n $proc ./dnsVariant $SIZE)
-                time1=$(echo $output | awk '{print $1}')
-                time2=$(echo $output | awk '{print $2}')
-
-                inputTime_par=$(echo "$inputTime_par + $time1" | bc -l)
-                calTime_par=$(echo "$calTime_par + $time2" | bc -l)
-
-            done
-
-            inputTime_par=$(echo "$inputTime_par / $MAX_RUNS" | bc -l)
-            calTime_par=$(echo "$calTime_par / $MAX_RUNS" | bc -l)
-            printf "Input Time: %10.6f  -  Calc Time: %10.6f\n" $inputTime_par $calTime_par
-
-            printf "%d;%10.6f;%10.6f\n" $proc $inputTime_par $calTime_par >> $csv_file
-        fi
-    done
+    echo "Sequential and parallel measurements (median on $MAX_RUNS runs, up to $PROC processes)"
+    mpirun $MPIRUN_OPTS -n $PROC ./benchDns -r $MAX_RUNS -o ./measurements $SIZE
 
     exit 0
 }
@@ -149,8 +128,8 @@ check() {
         exit 1
     fi
 
-    if (( ($PROC % ($SIZE * $SIZE) != 0) || ($PROC < ($SIZE * $SIZE)) ||  ($PROC > ($SIZE * $SIZE * $SIZE)) )); then
-        echo "Error: Number of processes must be a multiple of $SIZE^2, comprised between $SIZE^2 and $SIZE^3."
+    if (( $PROC < 1 )); then
+        echo "Error: Number of processes must be at least 1."
         exit 1
     fi
 
@@ -162,7 +141,7 @@ check() {
     printf "done\n"
 
     printf "\t Parallel computation ... "   
-    mpirun --oversubscribe -n $PROC ./dnsVariant $SIZE > /dev/null
+    mpirun $MPIRUN_OPTS -n $PROC ./dnsVariant $SIZE > /dev/null
     printf "done\n"
 
     digestSequential=$(md5sum matrixC_sequential.bin | awk '{print $1}')
@@ -179,7 +158,60 @@ check() {
     exit 0
 }
 
-while getopts ":bdn:mcp:" opt; do
+verify() {
+    if (( $PROC < 1 )); then
+        echo "Error: Number of processes must be at least 1."
+        exit 1
+    fi
+
+    echo "-------------------------------------------------------------------------------------------------------"
+    printf "Freivalds check (Matrix size: %d * %d)\n" $SIZE $SIZE
+
+    if mpirun $MPIRUN_OPTS -n $PROC ./dnsVariant -v -o replicated $SIZE > /dev/null; then
+        echo -e '\033[1mMatrix C passed the check\033[0m'
+    else
+        echo -e '\033[1mMatrix C failed the check\033[0m'
+    fi
+
+    exit 0
+}
+
+serverCheck() {
+    if ! command -v socat > /dev/null; then
+        echo "Error: socat is required for the server check."
+        exit 1
+    fi
+
+    echo "-------------------------------------------------------------------------------------------------------"
+    printf "Server check (Matrix size: %d * %d)\n" $SIZE $SIZE
+
+    local socket="/tmp/dnsVariant_check_$$.sock"
+    rm -f matrixC_server.bin
+    timeout 120 mpirun $MPIRUN_OPTS -n $PROC ./dnsVariant -s $socket $SIZE > /dev/null 2>&1 &
+    local server=$!
+    for i in $(seq 100); do
+        [ -S $socket ] && break
+        sleep 0.2
+    done
+
+    # A rejected request followed by quit must stop the server, not run the rejected product
+    local replies=$(printf "missingA.bin missingB.bin matrixC_server.bin\nmatrixA.bin matrixB.bin matrixC_server.bin\nmissingA.bin missingB.bin matrixC_server.bin\nquit\n" | socat -t 60 - UNIX-CONNECT:$socket)
+    wait $server
+    local status=$?
+    local expected=$(printf "ERR\nOK\nERR\nBYE")
+
+    if [ "$(echo "$replies" | awk '{print $1}')" = "$expected" ] && [ $status -eq 0 ] && [ -e matrixC_server.bin ]; then
+        echo -e '\033[1mThe server passed the check\033[0m'
+    else
+        echo -e '\033[1mThe server failed the check\033[0m'
+        printf "Replies:\n%s\nExit status: %d\n" "$replies" $status
+    fi
+    rm -f matrixC_server.bin
+
+    exit 0
+}
+
+while getopts ":bdt:n:mcvsp:" opt; do
     case ${opt} in
         b )
             build
@@ -187,6 +219,10 @@ while getopts ":bdn:mcp:" opt; do
         d )
             clean
             ;;
+        t )
+            export OMP_NUM_THREADS=$OPTARG
+            MPIRUN_OPTS="--map-by slot:PE=$OPTARG --bind-to core"
+            ;;
         n )
             SIZE=$OPTARG
             ;;
@@ -199,6 +235,12 @@ while getopts ":bdn:mcp:" opt; do
         c )
             C_FLAG=1
             ;;
+        v )
+            V_FLAG=1
+            ;;
+        s )
+            S_FLAG=1
+            ;;
         :) printf "Missing argument for -%s\n" "$OPTARG" >&2; usage
             ;;
         \?) printf "Illegal option: -%s\n" "$OPTARG" >&2; usage
@@ -213,9 +255,9 @@ if [[ -z $SIZE ]]; then
     usage "$0"
 fi
 
-# Check if -m and -c are used together
-if [[ $M_FLAG -eq $C_FLAG ]]; then
-    echo "Error: One of the options -m or -c must be used"
+# Check that exactly one of -m, -c, -v and -s is used
+if [[ $((M_FLAG + C_FLAG + V_FLAG + S_FLAG)) -ne 1 ]]; then
+    echo "Error: One of the options -m, -c, -v or -s must be used"
     usage "$0"
 fi
 
@@ -234,3 +276,20 @@ if [[ -n $SIZE && ($C_FLAG -eq 1) ]]; then
     check
 fi
 
+if [[ -n $SIZE && ($V_FLAG -eq 1) ]]; then
+    if [[ -z $PROC ]]; then
+        echo "Error: -p PROC is required"
+        usage "$0"
+    fi
+    generateInput
+    verify
+fi
+
+if [[ -n $SIZE && ($S_FLAG -eq 1) ]]; then
+    if [[ -z $PROC ]]; then
+        echo "Error: -p PROC is required"
+        usage "$0"
+    fi
+    generateInput
+    serverCheck
+fi
@@ -3,40 +3,110 @@
  * @brief Sequential matrix multiplication program
  *
  * This program performs matrix multiplication sequentially using the provided matrices.
- * It reads two matrices from binary files, multiplies them, and stores the result in a third matrix.
- * The program measures the execution time and outputs it along with the input time.
+ * It maps two matrices from binary files, multiplies them, and stores the result in a third matrix.
+ * The matrices may be rectangular, their sizes are read from the file headers.
+ * The program measures the execution time (wall time) and outputs it along with the input time.
  *
  * The input matrices should be in the same directory and named matrixA.bin and matrixB.bin
  * The result matrix is written to a binary file named matrixC_sequential.bin
+ *
+ * With -m the program works out of core within the given memory: tiles of A and B are read
+ * from the files with pread, a prefetch thread loads the next pair while the current one is
+ * multiplied, and every tile of C is written as soon as it is complete.
  */
 
+//clock_gettime and CLOCK_MONOTONIC, pread and ftruncate are POSIX.1-2008
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "inOutUtils.h"
+#include "gemmKernel.h"
 
+/**
+ * @struct TileLoad
+ * @brief Pair of tiles, A(row, depth) and B(depth, col), read from the files.
+ */
+typedef struct {
+    int fdA; /**< Descriptor of the file of A */
+    int fdB; /**< Descriptor of the file of B */
+    const MatrixFileHeader* headerA; /**< Header of the file of A */
+    const MatrixFileHeader* headerB; /**< Header of the file of B */
+    size_t row; /**< First row of the tiles of A and C */
+    size_t col; /**< First column of the tiles of B and C */
+    size_t depth; /**< First column of the tile of A and first row of the tile of B */
+    int rows; /**< Rows of the tiles of A and C */
+    int cols; /**< Columns of the tiles of B and C */
+    int inner; /**< Columns of the tile of A and rows of the tile of B */
+    int ld; /**< Leading dimension of the tiles */
+    elem_t* tileA; /**< Buffer of the tile of A */
+    elem_t* tileB; /**< Buffer of the tile of B */
+    int status; /**< 0 if both tiles were read */
+} TileLoad;
 
-#ifndef CLOCK_MONOTONIC
-#define CLOCK_MONOTONIC 1
-#endif
 /**
  * @brief Performs sequential matrix multiplication
  *
  * This function multiplies two matrices sequentially and stores the result in a third matrix.
  *
- * @param matrixA Pointer to the first matrix
- * @param matrixB Pointer to the second matrix
- * @param matrixC Pointer to the result matrix
- * @param n The size of the matrices
+ * @param matrixA Pointer to the first matrix, rows*inner
+ * @param matrixB Pointer to the second matrix, inner*cols
+ * @param matrixC Pointer to the result matrix, rows*cols
+ * @param rows The number of rows of A and C
+ * @param cols The number of columns of B and C
+ * @param inner The number of columns of A and rows of B
+ */
+void sequentialMatrixMultiply(elem_t* matrixA, elem_t* matrixB, elem_t* matrixC, int rows, int cols, int inner);
+
+/**
+ * @brief Multiplies two matrix files out of core and prints the times
+ *
+ * @param fileA Name of the file of the first matrix
+ * @param fileB Name of the file of the second matrix
+ * @param fileC Name of the file receiving the result, in row-major order
+ * @param size Required size of the square matrices, 0 to accept any compatible sizes
+ * @param memory Bytes available for the tiles
+ * @return 0 on success, otherwise the same error codes of main
+ */
+int streamMatrixMultiply(char* fileA, char* fileB, char* fileC, int size, size_t memory);
+
+/**
+ * @brief Loads a pair of tiles, used as body of the prefetch thread
+ *
+ * @param arg Pointer to the TileLoad to fill
+ * @return NULL
  */
-void sequentialMatrixMultiply(int* matrixA, int* matrixB, int* matrixC, int n);
+void* loadTiles(void* arg);
+
+/**
+ * @brief Returns a mapped matrix in row-major order
+ *
+ * Row-major files are used straight from the mapping, other layouts are copied and reordered.
+ *
+ * @param mapped Pointer to the mapped matrix
+ * @param owned Set to 1 if the returned buffer was allocated and must be freed
+ * @return Pointer to the matrix in row-major order, NULL if the allocation failed
+ */
+elem_t* rowMajorData(MappedMatrix* mapped, int* owned);
+
+/**
+ * @brief Returns the current wall time
+ *
+ * @return Seconds from an arbitrary fixed point
+ */
+double wallTime(void);
 
 /**
  * @brief Main function
  *
- * The main function reads the size of the matrices from the command line arguments.
- * It allocates memory for the matrices, reads the matrices from binary files,
- * performs sequential matrix multiplication, measures the execution time,
+ * The main function maps the input matrices, whose sizes are read from the file headers.
+ * If a size is given on the command line the matrices must be square of that size.
+ * It performs sequential matrix multiplication, measures the execution time,
  * and outputs the input time and total time.
  *
  * @param argc The number of command line arguments
@@ -44,24 +114,49 @@ void sequentialMatrixMultiply(int* matrixA, int* matrixB, int* matrixC, int n);
  * @return 0 if the program executed successfully, otherwise a non-zero value
  */
 int main(int argc, char* argv[]){  
-    clock_t total_time;
-    clock_t input_time;
+    double total_time;
+    double input_time;
+    MappedMatrix mappedA, mappedB;
+    int ownedA, ownedB;
+    size_t memory = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "m:")) != -1){
+        if(opt != 'm' || (memory = strtoull(optarg, NULL, 10) << 20) == 0){
+            optind = argc + 1;
+            break;
+        }
+    }
 
     // Check if the correct number of command line arguments is provided
-    if(argc != 2){
-        fprintf(stdout, "Usage: ./seqMatrixMultiply [size]\n");
+    if(optind < argc - 1 || optind > argc){
+        fprintf(stdout, "Usage: ./seqMatrixMultiply [-m memory MiB] [size]\n");
         return 1;
     }
-
-    int n = strtol(argv[1], NULL, 10);
+    if(memory > 0){
+        return streamMatrixMultiply("matrixA.bin", "matrixB.bin", "matrixC_sequential.bin", optind < argc ? atoi(argv[optind]) : 0, memory);
+    }
 
     /* Start the timer */
-    total_time = -clock();
+    total_time = -wallTime();
+
+    // Map the matrices and verify their checksums
+    if(mapMatrixFile(&mappedA, "matrixA.bin", 1) || mapMatrixFile(&mappedB, "matrixB.bin", 1)){
+        fprintf(stdout, "Error reading matrixA or matrixB\n");
+        return 3;
+    }
 
-    // Allocate memory for the matrices
-    int *matrixA = malloc(n*n*sizeof(int));
-    int *matrixB = malloc(n*n*sizeof(int));
-    int *matrixC = malloc(n*n*sizeof(int));
+    int rows = mappedA.header.rows;
+    int inner = mappedA.header.cols;
+    int cols = mappedB.header.cols;
+    if(mappedB.header.rows != (uint64_t)inner || (optind < argc && (rows != atoi(argv[optind]) || inner != rows || cols != rows))){
+        fprintf(stdout, "Error: matrixA is %d*%d and matrixB is %d*%d\n", rows, inner, (int)mappedB.header.rows, cols);
+        return 3;
+    }
+
+    elem_t *matrixA = rowMajorData(&mappedA, &ownedA);
+    elem_t *matrixB = rowMajorData(&mappedB, &ownedB);
+    elem_t *matrixC = malloc((size_t)rows*cols*sizeof(elem_t));
 
     // Check if memory allocation was successful
     if(matrixA == NULL || matrixB == NULL || matrixC == NULL){
@@ -69,34 +164,28 @@ int main(int argc, char* argv[]){
         return 2;
     }
 
-    // Read the matrices from binary files
-    if(readMatrixFromFile(matrixA, n, "matrixA.bin") || readMatrixFromFile(matrixB, n, "matrixB.bin")){
-        fprintf(stdout, "Error reading matrixA or matrixB\n");
-        return 3;
-    }
-
-    input_time = total_time + clock();
+    input_time = total_time + wallTime();
 
     // Perform sequential matrix multiplication
-    sequentialMatrixMultiply(matrixA, matrixB, matrixC, n);
+    sequentialMatrixMultiply(matrixA, matrixB, matrixC, rows, cols, inner);
 
-    total_time += clock();
+    total_time += wallTime();
 
-    double t_input = (double) input_time/CLOCKS_PER_SEC;
-    double t_total = (double) total_time/CLOCKS_PER_SEC;
     // Output the input time and total time
-    printf("%10.6f\t%10.6f\n", t_input, t_total-t_input);
+    printf("%10.6f\t%10.6f\n", input_time, total_time-input_time);
     
     // Write the result matrix to a binary file
-    if(writeMatrixToFile(matrixC, n, "matrixC_sequential.bin")){
+    if(writeRectMatrixToFile(matrixC, rows, cols, LAYOUT_ROW_MAJOR, 0, "matrixC_sequential.bin")){
         fprintf(stdout, "Error writing matrixC\n");
         return 4;
     }
     
     // Free the allocated memory
-    free(matrixA);
-    free(matrixB);
+    if(ownedA) free(matrixA);
+    if(ownedB) free(matrixB);
     free(matrixC);
+    unmapMatrixFile(&mappedA);
+    unmapMatrixFile(&mappedB);
 
     return 0;
 }
@@ -105,20 +194,219 @@ int main(int argc, char* argv[]){
  * @brief Performs sequential matrix multiplication
  *
  * This function multiplies two matrices sequentially and stores the result in a third matrix.
- * It uses three nested loops to iterate over the elements of the matrices and perform the multiplication.
+ * It clears the result and hands the product to the cache blocked kernel in gemmKernel.c,
+ * the same one used by the block based parallel version.
  *
- * @param matrixA Pointer to the first matrix
- * @param matrixB Pointer to the second matrix
- * @param matrixC Pointer to the result matrix
- * @param n The size of the matrices
+ * @param matrixA Pointer to the first matrix, rows*inner
+ * @param matrixB Pointer to the second matrix, inner*cols
+ * @param matrixC Pointer to the result matrix, rows*cols
+ * @param rows The number of rows of A and C
+ * @param cols The number of columns of B and C
+ * @param inner The number of columns of A and rows of B
  */
-void sequentialMatrixMultiply(int* matrixA, int* matrixB, int* matrixC, int n){
-    for(int i = 0; i < n; i++){
-        for(int j = 0; j < n; j++){
-            matrixC[i*n+j] = 0;
-            for(int k = 0; k < n; k++){
-                matrixC[i*n+j] += matrixA[i*n+k] * matrixB[k*n+j];
+void sequentialMatrixMultiply(elem_t* matrixA, elem_t* matrixB, elem_t* matrixC, int rows, int cols, int inner){
+    memset(matrixC, 0, (size_t)rows*cols*sizeof(elem_t));
+    gemmKernel(matrixA, matrixB, matrixC, rows, cols, inner, inner, cols, cols);
+}
+
+/**
+ * @brief Multiplies two matrix files out of core and prints the times
+ *
+ * The memory holds five square tiles of side t: two pairs of tiles of A and B, the one being
+ * multiplied and the one being loaded by the prefetch thread, and the tile of C. For every
+ * tile of C the tiles of the block-row of A and of the block-column of B are streamed along
+ * the inner dimension, so the inputs are read about n/t times each and C exactly once.
+ * The input files may be in any layout, and their checksums are verified in a first pass,
+ * which is counted as input time.
+ *
+ * @param fileA Name of the file of the first matrix
+ * @param fileB Name of the file of the second matrix
+ * @param fileC Name of the file receiving the result
+ * @param size Required size of the square matrices, 0 to accept any compatible sizes
+ * @param memory Bytes available for the tiles
+ * @return 0 on success, otherwise the same error codes of main
+ */
+int streamMatrixMultiply(char* fileA, char* fileB, char* fileC, int size, size_t memory){
+    double total_time = -wallTime();
+    double input_time;
+    MatrixFileHeader headerA, headerB, headerC;
+    TileLoad loads[2];
+    uint64_t checksum = 0;
+    int status = 0;
+
+    if(readMatrixInfo(&headerA, fileA) || readMatrixInfo(&headerB, fileB)){
+        fprintf(stdout, "Error reading matrixA or matrixB\n");
+        return 3;
+    }
+    int rows = headerA.rows;
+    int inner = headerA.cols;
+    int cols = headerB.cols;
+    if(headerB.rows != (uint64_t)inner || (size && (rows != size || inner != rows || cols != rows))){
+        fprintf(stdout, "Error: matrixA is %d*%d and matrixB is %d*%d\n", rows, inner, (int)headerB.rows, cols);
+        return 3;
+    }
+
+    int fdA = open(fileA, O_RDONLY);
+    int fdB = open(fileB, O_RDONLY);
+    if(fdA < 0 || fdB < 0 || verifyMatrixFile(fdA, &headerA) || verifyMatrixFile(fdB, &headerB)){
+        fprintf(stdout, "Error reading matrixA or matrixB\n");
+        if(fdA >= 0) close(fdA);
+        if(fdB >= 0) close(fdB);
+        return 3;
+    }
+
+    //Largest side of the tiles fitting the memory, a multiple of the register block when possible
+    int largest = rows > cols ? rows : cols;
+    largest = largest > inner ? largest : inner;
+    int tile = 1;
+    while(tile < largest && (size_t)(tile + 1)*(tile + 1)*5*sizeof(elem_t) <= memory) tile++;
+    if(tile > GEMM_NR && tile < largest) tile -= tile % GEMM_NR;
+
+    elem_t* tileC = malloc((size_t)tile*tile*sizeof(elem_t));
+    int allocationFailed = tileC == NULL;
+    for(int i = 0; i < 2; i++){
+        loads[i].fdA = fdA;
+        loads[i].fdB = fdB;
+        loads[i].headerA = &headerA;
+        loads[i].headerB = &headerB;
+        loads[i].ld = tile;
+        loads[i].tileA = malloc((size_t)tile*tile*sizeof(elem_t));
+        loads[i].tileB = malloc((size_t)tile*tile*sizeof(elem_t));
+        if(loads[i].tileA == NULL || loads[i].tileB == NULL) allocationFailed = 1;
+    }
+
+    initMatrixHeader(&headerC, rows, cols, LAYOUT_ROW_MAJOR, 0);
+    int fdC = -1;
+    if(!allocationFailed){
+        fdC = open(fileC, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    if(allocationFailed || fdC < 0 || ftruncate(fdC, sizeof(MatrixFileHeader) + (size_t)rows*cols*sizeof(elem_t))){
+        if(allocationFailed) fprintf(stdout, "Error allocating memory\n");
+        else fprintf(stdout, "Error writing matrixC\n");
+        if(fdC >= 0) close(fdC);
+        close(fdA);
+        close(fdB);
+        free(tileC);
+        for(int i = 0; i < 2; i++){
+            free(loads[i].tileA);
+            free(loads[i].tileB);
+        }
+        return allocationFailed ? 2 : 4;
+    }
+
+    input_time = total_time + wallTime();
+
+    //The first pair is loaded here, every following one while the previous is multiplied
+    int current = 0;
+    loads[0].row = loads[0].col = loads[0].depth = 0;
+    loads[0].rows = rows < tile ? rows : tile;
+    loads[0].cols = cols < tile ? cols : tile;
+    loads[0].inner = inner < tile ? inner : tile;
+    loadTiles(&loads[0]);
+    status = loads[0].status;
+
+    while(!status){
+        TileLoad* now = &loads[current];
+        TileLoad* next = &loads[1 - current];
+        pthread_t prefetcher;
+        int prefetching;
+
+        //Walk along the inner dimension, then along the columns and the rows of C
+        next->row = now->row;
+        next->col = now->col;
+        next->depth = now->depth + tile;
+        if(next->depth >= (size_t)inner){
+            next->depth = 0;
+            next->col += tile;
+            if(next->col >= (size_t)cols){
+                next->col = 0;
+                next->row += tile;
             }
         }
+        int hasNext = next->row < (size_t)rows;
+        if(hasNext){
+            next->rows = rows - next->row < (size_t)tile ? (int)(rows - next->row) : tile;
+            next->cols = cols - next->col < (size_t)tile ? (int)(cols - next->col) : tile;
+            next->inner = inner - next->depth < (size_t)tile ? (int)(inner - next->depth) : tile;
+            prefetching = !pthread_create(&prefetcher, NULL, loadTiles, next);
+            if(!prefetching) loadTiles(next);
+        }
+
+        if(now->depth == 0) memset(tileC, 0, (size_t)tile*tile*sizeof(elem_t));
+        gemmKernel(now->tileA, now->tileB, tileC, now->rows, now->cols, now->inner, tile, tile, tile);
+        if(now->depth + now->inner == (size_t)inner){
+            status |= writeMatrixTile(fdC, &headerC, now->row, now->col, now->rows, now->cols, tileC, tile, &checksum);
+        }
+
+        if(!hasNext) break;
+        if(prefetching) pthread_join(prefetcher, NULL);
+        status |= next->status;
+        current = 1 - current;
+    }
+
+    headerC.checksum = checksum;
+    if(!status && pwrite(fdC, &headerC, sizeof(MatrixFileHeader), 0) != sizeof(MatrixFileHeader)) status = 1;
+    status |= close(fdC) != 0;
+    total_time += wallTime();
+
+    close(fdA);
+    close(fdB);
+    free(tileC);
+    for(int i = 0; i < 2; i++){
+        free(loads[i].tileA);
+        free(loads[i].tileB);
+    }
+
+    if(status){
+        fprintf(stdout, "Error streaming the matrices\n");
+        return 4;
     }
+    printf("%10.6f\t%10.6f\n", input_time, total_time-input_time);
+    return 0;
+}
+
+/**
+ * @brief Loads a pair of tiles, used as body of the prefetch thread
+ *
+ * @param arg Pointer to the TileLoad to fill
+ * @return NULL
+ */
+void* loadTiles(void* arg){
+    TileLoad* load = arg;
+    load->status = readMatrixTile(load->fdA, load->headerA, load->row, load->depth, load->rows, load->inner, load->tileA, load->ld) ||
+                   readMatrixTile(load->fdB, load->headerB, load->depth, load->col, load->inner, load->cols, load->tileB, load->ld);
+    return NULL;
+}
+
+/**
+ * @brief Returns a mapped matrix in row-major order
+ *
+ * @param mapped Pointer to the mapped matrix
+ * @param owned Set to 1 if the returned buffer was allocated and must be freed
+ * @return Pointer to the matrix in row-major order, NULL if the allocation failed
+ */
+elem_t* rowMajorData(MappedMatrix* mapped, int* owned){
+    *owned = mapped->header.layout != LAYOUT_ROW_MAJOR;
+    if(!*owned){
+        return mapped->data;
+    }
+    elem_t* matrix = malloc(mapped->header.rows*mapped->header.cols*sizeof(elem_t));
+    if(matrix != NULL){
+        mappedMatrixToRowMajor(mapped, matrix);
+    }
+    return matrix;
+}
+
+/**
+ * @brief Returns the current wall time
+ *
+ * clock() would measure the CPU time of the process, which is not comparable with
+ * the MPI_Wtime of the parallel version, especially when the kernel uses several threads.
+ *
+ * @return Seconds from an arbitrary fixed point
+ */
+double wallTime(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
 }
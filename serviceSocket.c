@@ -0,0 +1,124 @@
+/**
+ * @file serviceSocket.c
+ * @brief This file contains the Unix domain socket used by the server mode.
+ *
+ * The protocol is line based, so that any tool able to talk to a Unix socket
+ * (for example socat) can be used as a client.
+ */
+
+#include "serviceSocket.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief Creates the socket and starts listening.
+ * 
+ * Only a socket, e.g. the one of a server that did not stop cleanly, is removed from
+ * the path before binding; a regular file or directory there makes the call fail.
+ * 
+ * @param service Pointer to the socket to initialize.
+ * @param path The path of the socket in the file system.
+ * @return 0 if the socket is listening, 1 otherwise.
+ */
+int openServiceSocket(ServiceSocket* service, const char* path){
+    struct sockaddr_un address;
+
+    if(strlen(path) >= sizeof(address.sun_path)){
+        return 1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    strcpy(service->path, path);
+    service->client = -1;
+    service->input = NULL;
+
+    struct stat info;
+    if(lstat(path, &info) == 0){
+        if(!S_ISSOCK(info.st_mode) || unlink(path)){
+            return 1;
+        }
+    }else if(errno != ENOENT){
+        return 1;
+    }
+
+    service->server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(service->server < 0){
+        return 1;
+    }
+    if(bind(service->server, (struct sockaddr*)&address, sizeof(address)) || listen(service->server, 8)){
+        close(service->server);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Waits for the next request line.
+ * 
+ * @param service Pointer to the socket.
+ * @param line The buffer receiving the line.
+ * @param size The size of the buffer.
+ * @return 0 if a line was read, 1 if the socket failed, 2 if the line was too long.
+ */
+int readServiceRequest(ServiceSocket* service, char* line, int size){
+    while(1){
+        if(service->input == NULL){
+            service->client = accept(service->server, NULL, NULL);
+            if(service->client < 0){
+                return 1;
+            }
+            service->input = fdopen(service->client, "r");
+            if(service->input == NULL){
+                close(service->client);
+                return 1;
+            }
+        }
+
+        if(fgets(line, size, service->input) != NULL){
+            size_t length = strcspn(line, "\n");
+            if(line[length] != '\n' && !feof(service->input)){
+                //The buffer is full before the end of the line, skip the rest of it
+                int c;
+                while((c = getc(service->input)) != EOF && c != '\n');
+                return 2;
+            }
+            line[strcspn(line, "\r\n")] = '\0';
+            return 0;
+        }
+
+        //The client closed the connection, wait for the next one
+        fclose(service->input);
+        service->input = NULL;
+        service->client = -1;
+    }
+}
+
+/**
+ * @brief Sends a reply line to the current client.
+ * 
+ * MSG_NOSIGNAL keeps a client that went away from killing the server with SIGPIPE.
+ * 
+ * @param service Pointer to the socket.
+ * @param reply The reply, without the trailing newline.
+ */
+void sendServiceReply(ServiceSocket* service, const char* reply){
+    if(service->client < 0) return;
+    send(service->client, reply, strlen(reply), MSG_NOSIGNAL);
+    send(service->client, "\n", 1, MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Closes the connections and removes the socket from the file system.
+ * 
+ * @param service Pointer to the socket.
+ */
+void closeServiceSocket(ServiceSocket* service){
+    if(service->input != NULL) fclose(service->input);
+    close(service->server);
+    unlink(service->path);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file serviceSocket.h
+ * @brief Header file containing the Unix domain socket used by the server mode.
+ */
+
+#ifndef SERVICESOCKET_H
+#define SERVICESOCKET_H
+
+#include <stdio.h>
+
+/**
+ * @struct ServiceSocket
+ * @brief Listening socket of the server and the client being served.
+ *
+ * Clients are served one at a time: a client sends one request per line and
+ * receives one reply per line, until it closes the connection.
+ */
+typedef struct {
+    int server; /**< Listening socket */
+    int client; /**< Connected client, -1 if none */
+    FILE* input; /**< Stream reading the lines of the client */
+    char path[108]; /**< Path of the socket in the file system */
+} ServiceSocket;
+
+/**
+ * @brief Creates the socket and starts listening.
+ * 
+ * A socket left at the same path by an earlier server is replaced, any other file
+ * is left alone and makes the call fail.
+ * 
+ * @param service Pointer to the socket to initialize.
+ * @param path Path of the socket in the file system.
+ * @return 0 if the socket is listening, 1 otherwise.
+ */
+int openServiceSocket(ServiceSocket* service, const char* path);
+
+/**
+ * @brief Waits for the next request line.
+ * 
+ * When the current client has no more lines the next client is accepted.
+ * The trailing newline is removed. A line not fitting the buffer is read to its end
+ * and discarded, so that its tail is not taken for a new request.
+ * 
+ * @param service Pointer to the socket.
+ * @param line Buffer receiving the line.
+ * @param size Size of the buffer.
+ * @return 0 if a line was read, 1 if the socket failed, 2 if the line was too long.
+ */
+int readServiceRequest(ServiceSocket* service, char* line, int size);
+
+/**
+ * @brief Sends a reply line to the current client.
+ * 
+ * A client that already went away is silently ignored.
+ * 
+ * @param service Pointer to the socket.
+ * @param reply Reply, without the trailing newline.
+ */
+void sendServiceReply(ServiceSocket* service, const char* reply);
+
+/**
+ * @brief Closes the connections and removes the socket from the file system.
+ * 
+ * @param service Pointer to the socket.
+ */
+void closeServiceSocket(ServiceSocket* service);
+
+#endif // SERVICESOCKET_H
@@ -0,0 +1,171 @@
+/**
+ * @file summaEngine.c
+ * @brief This file contains the SUMMA multiplication engine for rectangular grids.
+ *
+ * Cannon's shifts need square groups of processes. SUMMA only needs every process to see,
+ * at each step, a panel of columns of A from its grid row and the matching panel of rows
+ * of B from its grid column, so the grid may have any shape and the matrices any size.
+ * The panels travel with nonblocking broadcasts: the ones of step i+1 are started before
+ * the ones of step i are waited for, so they move while step i is multiplied.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "summaEngine.h"
+#include "gemmKernel.h"
+#include "phaseProfiler.h"
+
+/**
+ * @brief Builds the gridRows*gridCols process grid and its communicators.
+ *
+ * @param ctx Pointer to the context to initialize.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param rows The rows of A and C.
+ * @param inner The columns of A and rows of B.
+ * @param cols The columns of B and C.
+ * @param gridRows The rows of the grid.
+ * @param gridCols The columns of the grid.
+ * @param panel The maximum width of the panels.
+ */
+void createSummaContext(SummaContext* ctx, MPI_Comm parent, int rows, int inner, int cols, int gridRows, int gridCols, int panel){
+    int dims[2] = {gridRows, gridCols};
+    int periods[2] = {0, 0};
+    int coords[2];
+    int remaining_dims[2];
+
+    ctx->gridRows = gridRows;
+    ctx->gridCols = gridCols;
+    ctx->rows = rows;
+    ctx->inner = inner;
+    ctx->cols = cols;
+    ctx->tileRows = (rows + gridRows - 1) / gridRows;
+    ctx->tileCols = (cols + gridCols - 1) / gridCols;
+    ctx->tileInnerA = (inner + gridCols - 1) / gridCols;
+    ctx->tileInnerB = (inner + gridRows - 1) / gridRows;
+    ctx->panel = panel;
+
+    MPI_Cart_create(parent, 2, dims, periods, 0, &ctx->commGrid);
+    MPI_Comm_rank(ctx->commGrid, &ctx->gridRank);
+    MPI_Cart_coords(ctx->commGrid, ctx->gridRank, 2, coords);
+    ctx->row = coords[0];
+    ctx->col = coords[1];
+
+    remaining_dims[0] = 0;
+    remaining_dims[1] = 1;
+    MPI_Cart_sub(ctx->commGrid, remaining_dims, &ctx->commXsingleDim);
+
+    remaining_dims[0] = 1;
+    remaining_dims[1] = 0;
+    MPI_Cart_sub(ctx->commGrid, remaining_dims, &ctx->commYsingleDim);
+}
+
+/**
+ * @brief Frees the communicators of a context.
+ *
+ * @param ctx Pointer to the context to free.
+ */
+void freeSummaContext(SummaContext* ctx){
+    MPI_Comm_free(&ctx->commXsingleDim);
+    MPI_Comm_free(&ctx->commYsingleDim);
+    MPI_Comm_free(&ctx->commGrid);
+}
+
+/**
+ * @brief Packs the panels starting at column k of A and row k of B and starts their broadcasts.
+ *
+ * The panel ends at the first of: the panel width, the end of the tile of A holding
+ * column k, the end of the tile of B holding row k, the end of the inner dimension.
+ * The owners copy it from their tiles, so that every process multiplies contiguous panels.
+ *
+ * @param ctx The pointer to the context.
+ * @param localA The tile of A of the process.
+ * @param localB The tile of B of the process.
+ * @param k The first index of the panel in the inner dimension.
+ * @param panelA The buffer receiving the panel of A.
+ * @param panelB The buffer receiving the panel of B.
+ * @param requests The two requests of the broadcasts.
+ * @return The width of the panel.
+ */
+static int startPanel(SummaContext* ctx, elem_t* localA, elem_t* localB, int k, elem_t* panelA, elem_t* panelB, MPI_Request* requests){
+    int ownerA = k / ctx->tileInnerA; //Grid column owning column k of A
+    int ownerB = k / ctx->tileInnerB; //Grid row owning row k of B
+    int offsetA = k - ownerA*ctx->tileInnerA;
+    int offsetB = k - ownerB*ctx->tileInnerB;
+
+    int width = ctx->panel;
+    if(width > ctx->tileInnerA - offsetA) width = ctx->tileInnerA - offsetA;
+    if(width > ctx->tileInnerB - offsetB) width = ctx->tileInnerB - offsetB;
+    if(width > ctx->inner - k) width = ctx->inner - k;
+
+    if(ctx->col == ownerA){
+        for(int i = 0; i < ctx->tileRows; i++){
+            memcpy(panelA + (size_t)i*width, localA + (size_t)i*ctx->tileInnerA + offsetA, width*sizeof(elem_t));
+        }
+    }
+    if(ctx->row == ownerB){
+        memcpy(panelB, localB + (size_t)offsetB*ctx->tileCols, (size_t)width*ctx->tileCols*sizeof(elem_t));
+    }
+
+    MPI_Ibcast(panelA, ctx->tileRows*width, MPI_ELEM, ownerA, ctx->commXsingleDim, &requests[0]);
+    MPI_Ibcast(panelB, width*ctx->tileCols, MPI_ELEM, ownerB, ctx->commYsingleDim, &requests[1]);
+    return width;
+}
+
+/**
+ * @brief Multiplies the distributed matrices, accumulating the tile of C of the process.
+ *
+ * Two buffers per operand are used: while the panels in one pair are multiplied, the
+ * broadcasts of the next panels fill the other pair. Only the wait not hidden by the
+ * multiplication is timed.
+ *
+ * @param ctx Pointer to the context.
+ * @param localA The tile of A.
+ * @param localB The tile of B.
+ * @param localC The tile of C where the product is accumulated.
+ */
+void summaMultiply(SummaContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC){
+    int tileRows = ctx->tileRows;
+    int tileCols = ctx->tileCols;
+    elem_t* panelA[2]; /**< Current and next panel of A */
+    elem_t* panelB[2]; /**< Current and next panel of B */
+    MPI_Request requests[2][2]; /**< Broadcasts of the panels, indexed by the buffer */
+
+    for(int i = 0; i < 2; i++){
+        panelA[i] = malloc((size_t)tileRows*ctx->panel*sizeof(elem_t));
+        panelB[i] = malloc((size_t)ctx->panel*tileCols*sizeof(elem_t));
+        if(panelA[i]==NULL || panelB[i]==NULL){
+            printf("Abort... error allocating memory.\n");
+            MPI_Abort(MPI_COMM_WORLD, 2);
+        }
+    }
+
+    int current = 0; //Index of the buffers holding the panels of the current step
+    int width = startPanel(ctx, localA, localB, 0, panelA[0], panelB[0], requests[0]);
+    for(int k = 0; k < ctx->inner; ){
+        int nextWidth = 0;
+        if(k + width < ctx->inner){
+            nextWidth = startPanel(ctx, localA, localB, k + width, panelA[1-current], panelB[1-current], requests[1-current]);
+        }
+
+        phaseBegin(PHASE_PANEL_A);
+        MPI_Wait(&requests[current][0], MPI_STATUS_IGNORE);
+        phaseEnd(PHASE_PANEL_A, (double)tileRows*width*sizeof(elem_t));
+        phaseBegin(PHASE_PANEL_B);
+        MPI_Wait(&requests[current][1], MPI_STATUS_IGNORE);
+        phaseEnd(PHASE_PANEL_B, (double)width*tileCols*sizeof(elem_t));
+
+        phaseBegin(PHASE_COMPUTE);
+        gemmKernel(panelA[current], panelB[current], localC, tileRows, tileCols, width, width, tileCols, tileCols);
+        phaseEnd(PHASE_COMPUTE, 0);
+
+        current = 1 - current;
+        k += width;
+        width = nextWidth;
+    }
+
+    for(int i = 0; i < 2; i++){
+        free(panelA[i]);
+        free(panelB[i]);
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file summaEngine.h
+ * @brief Header file containing the SUMMA multiplication engine for rectangular grids.
+ *
+ * The engine owns a rows*cols process grid, which need not be square, and multiplies
+ * rectangular matrices distributed on it in tiles. As for the DNS engine, reading the
+ * inputs and delivering the result are left to the caller.
+ */
+
+#ifndef SUMMAENGINE_H
+#define SUMMAENGINE_H
+
+#include "mpi.h"
+#include "matrixType.h"
+
+/**
+ * @def SUMMA_PANEL
+ * @brief Default maximum width of the panels broadcast at every step.
+ */
+#define SUMMA_PANEL 64
+
+/**
+ * @struct SummaContext
+ * @brief Process grid of the SUMMA engine and shape of the tiles.
+ *
+ * A is rows*inner, B is inner*cols and C is rows*cols. The process (r, c) owns the tile
+ * (r, c) of every matrix: tiles of A are split in gridRows*gridCols like those of C, and so
+ * are the tiles of B, so the inner dimension is cut in gridCols pieces for A and in gridRows
+ * pieces for B. Tiles are padded with zeros up to their full size.
+ */
+typedef struct {
+    MPI_Comm commGrid; /**< Cartesian communicator of the grid */
+    MPI_Comm commXsingleDim; /**< Communicator for processes of the same grid row, the rank is the column */
+    MPI_Comm commYsingleDim; /**< Communicator for processes of the same grid column, the rank is the row */
+    int gridRank; /**< The rank of the current process in the grid */
+    int row; /**< The grid row of the current process */
+    int col; /**< The grid column of the current process */
+    int gridRows; /**< The number of rows of the grid */
+    int gridCols; /**< The number of columns of the grid */
+    int rows; /**< Rows of A and C */
+    int inner; /**< Columns of A and rows of B */
+    int cols; /**< Columns of B and C */
+    int tileRows; /**< Rows of the tiles of A and C, ceil(rows/gridRows) */
+    int tileCols; /**< Columns of the tiles of B and C, ceil(cols/gridCols) */
+    int tileInnerA; /**< Columns of the tiles of A, ceil(inner/gridCols) */
+    int tileInnerB; /**< Rows of the tiles of B, ceil(inner/gridRows) */
+    int panel; /**< Maximum width of the panels */
+} SummaContext;
+
+/**
+ * @brief Builds the gridRows*gridCols process grid and its communicators.
+ *
+ * This is a collective operation over parent, which must have exactly gridRows*gridCols processes.
+ *
+ * @param ctx Pointer to the context to initialize.
+ * @param parent Communicator of the processes taking part in the grid.
+ * @param rows Rows of A and C.
+ * @param inner Columns of A and rows of B.
+ * @param cols Columns of B and C.
+ * @param gridRows Rows of the grid.
+ * @param gridCols Columns of the grid.
+ * @param panel Maximum width of the panels.
+ */
+void createSummaContext(SummaContext* ctx, MPI_Comm parent, int rows, int inner, int cols, int gridRows, int gridCols, int panel);
+
+/**
+ * @brief Frees the communicators of a context.
+ *
+ * @param ctx Pointer to the context to free.
+ */
+void freeSummaContext(SummaContext* ctx);
+
+/**
+ * @brief Multiplies the distributed matrices, accumulating the tile of C of the process.
+ *
+ * The inner dimension is walked in panels no wider than ctx->panel and never crossing a
+ * tile: every panel of A is broadcast along the grid rows and every panel of B along
+ * the grid columns, while the previous panels are multiplied.
+ *
+ * @param ctx Pointer to the context.
+ * @param localA Tile of A, tileRows*tileInnerA elements.
+ * @param localB Tile of B, tileInnerB*tileCols elements.
+ * @param localC Tile of C, tileRows*tileCols elements, where the product is accumulated.
+ */
+void summaMultiply(SummaContext* ctx, elem_t* localA, elem_t* localB, elem_t* localC);
+
+#endif // SUMMAENGINE_H
@@ -0,0 +1,168 @@
+/**
+ * @file tuningCache.c
+ * @brief This file contains the cache of the configurations found by the autotuner.
+ *
+ * The tuning file is plain text, one configuration per line:
+ *
+ *     machine engine distribution n p q m mc kc nc time
+ *
+ * The engine and the distribution are part of the key, since they move different amounts
+ * of data and so prefer different grids. Lines starting with '#' are comments, and so
+ * count the lines of older files without the engine and the distribution. benchDns -a writes the file and dnsVariant reads it
+ * when the grid is not given on the command line.
+ */
+
+#include "tuningCache.h"
+#include "gemmKernel.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @def TUNING_LINE_LEN
+ * @brief Maximum length of a line of the tuning file.
+ */
+#define TUNING_LINE_LEN 512
+
+/**
+ * @def TUNING_NAME_LEN
+ * @brief Maximum length of the name of an engine or a distribution.
+ */
+#define TUNING_NAME_LEN 16
+
+static const char* engineNames[] = {"cannon", "pipelined", "25d", "summa", "shm", "rma"}; /**< Names of the engines, as given to -e */
+static const char* distributionNames[] = {"bcast", "fused"}; /**< Names of the distributions, as given to -d */
+
+/**
+ * @brief Parses a line of the tuning file.
+ *
+ * @param line The line to parse.
+ * @param machine The buffer of TUNING_MACHINE_LEN characters receiving the key of the machine.
+ * @param engine The buffer of TUNING_NAME_LEN characters receiving the name of the engine.
+ * @param distribution The buffer of TUNING_NAME_LEN characters receiving the name of the distribution.
+ * @param n The pointer receiving the size of the matrix.
+ * @param p The pointer receiving the number of processes.
+ * @param entry The pointer receiving the configuration.
+ * @return 0 if the line holds a configuration, 1 otherwise.
+ */
+static int parseTuningLine(const char* line, char* machine, char* engine, char* distribution, int* n, int* p, TuningEntry* entry){
+    if(line[0] == '#') return 1;
+    return sscanf(line, "%127s %15s %15s %d %d %d %d %d %d %d %lf", machine, engine, distribution, n, p,
+                  &entry->q, &entry->m, &entry->mc, &entry->kc, &entry->nc, &entry->time) != 11;
+}
+
+/**
+ * @brief Tells whether a parsed line has the key of a configuration.
+ *
+ * @param machine The key of the machine of the line.
+ * @param engine The name of the engine of the line.
+ * @param distribution The name of the distribution of the line.
+ * @param lineN The size of the matrix of the line.
+ * @param lineP The number of processes of the line.
+ * @param key The key of the machine looked for.
+ * @param n The size of the matrix looked for.
+ * @param p The number of processes looked for.
+ * @param wantedEngine The engine looked for.
+ * @param wantedDistribution The distribution looked for.
+ * @return 1 if the keys match, 0 otherwise.
+ */
+static int sameTuningKey(const char* machine, const char* engine, const char* distribution, int lineN, int lineP,
+                         const char* key, int n, int p, enum Engine wantedEngine, enum DistributionMode wantedDistribution){
+    return lineN == n && lineP == p && !strcmp(machine, key) &&
+           !strcmp(engine, engineNames[wantedEngine]) && !strcmp(distribution, distributionNames[wantedDistribution]);
+}
+
+/**
+ * @brief Builds the key identifying the machine.
+ *
+ * @param machine The buffer of TUNING_MACHINE_LEN characters receiving the key.
+ */
+void tuningMachine(char* machine){
+    char host[64] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    snprintf(machine, TUNING_MACHINE_LEN, "%s/%s/%s", host, ELEM_NAME, gemmKernelIsa());
+}
+
+/**
+ * @brief Looks up the configuration stored for a machine, a size, a number of processes,
+ * an engine and a distribution.
+ *
+ * A missing file is not an error, it simply holds no configuration.
+ *
+ * @param filename The path of the tuning file.
+ * @param machine The key of the machine.
+ * @param n The size of the matrix.
+ * @param p The number of processes.
+ * @param engine The strategy used for the shifts.
+ * @param distribution The strategy used to place the blocks.
+ * @param entry The pointer to the configuration to fill.
+ * @return 0 if a configuration was found, 1 otherwise.
+ */
+int lookupTuning(const char* filename, const char* machine, int n, int p, enum Engine engine, enum DistributionMode distribution, TuningEntry* entry){
+    char line[TUNING_LINE_LEN];
+    char key[TUNING_MACHINE_LEN];
+    char lineEngine[TUNING_NAME_LEN], lineDistribution[TUNING_NAME_LEN];
+    int lineN, lineP, found = 0;
+    TuningEntry current;
+
+    FILE* file = fopen(filename, "r");
+    if(file == NULL) return 1;
+
+    while(fgets(line, sizeof(line), file) != NULL){
+        if(parseTuningLine(line, key, lineEngine, lineDistribution, &lineN, &lineP, &current)) continue;
+        if(sameTuningKey(key, lineEngine, lineDistribution, lineN, lineP, machine, n, p, engine, distribution)){
+            *entry = current;
+            found = 1;
+        }
+    }
+
+    fclose(file);
+    return !found;
+}
+
+/**
+ * @brief Stores the configuration for a machine, a size, a number of processes, an engine
+ * and a distribution.
+ *
+ * The file is rewritten in a temporary file next to it, without the old configuration with
+ * the same key, and then renamed, so a reader never sees it half written.
+ *
+ * @param filename The path of the tuning file.
+ * @param machine The key of the machine.
+ * @param n The size of the matrix.
+ * @param p The number of processes.
+ * @param engine The strategy used for the shifts.
+ * @param distribution The strategy used to place the blocks.
+ * @param entry The configuration to store.
+ * @return 0 on success, 1 on failure.
+ */
+int storeTuning(const char* filename, const char* machine, int n, int p, enum Engine engine, enum DistributionMode distribution, const TuningEntry* entry){
+    char line[TUNING_LINE_LEN];
+    char key[TUNING_MACHINE_LEN];
+    char lineEngine[TUNING_NAME_LEN], lineDistribution[TUNING_NAME_LEN];
+    char temporary[TUNING_LINE_LEN];
+    int lineN, lineP;
+    TuningEntry current;
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+    FILE* output = fopen(temporary, "w");
+    if(output == NULL) return 1;
+
+    FILE* input = fopen(filename, "r");
+    if(input == NULL){
+        fprintf(output, "# machine engine distribution n p q m mc kc nc time\n");
+    }else{
+        while(fgets(line, sizeof(line), input) != NULL){
+            if(!parseTuningLine(line, key, lineEngine, lineDistribution, &lineN, &lineP, &current) &&
+               sameTuningKey(key, lineEngine, lineDistribution, lineN, lineP, machine, n, p, engine, distribution)) continue;
+            fputs(line, output);
+        }
+        fclose(input);
+    }
+
+    fprintf(output, "%s %s %s %d %d %d %d %d %d %d %.9f\n", machine, engineNames[engine], distributionNames[distribution], n, p, entry->q, entry->m,
+            entry->mc, entry->kc, entry->nc, entry->time);
+    if(fclose(output)) return 1;
+    return rename(temporary, filename) != 0;
+}
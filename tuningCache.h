@@ -0,0 +1,81 @@
+/**
+ * @file tuningCache.h
+ * @brief Header file containing the cache of the configurations found by the autotuner.
+ */
+
+#ifndef TUNINGCACHE_H
+#define TUNINGCACHE_H
+
+#include "dnsEngine.h"
+
+/**
+ * @def TUNING_FILE
+ * @brief Default path of the tuning file, relative to the working directory.
+ */
+#define TUNING_FILE "dnsTuning.txt"
+
+/**
+ * @def TUNING_MACHINE_LEN
+ * @brief Maximum length of the key identifying a machine.
+ */
+#define TUNING_MACHINE_LEN 128
+
+/**
+ * @struct TuningEntry
+ * @brief Best configuration measured for a matrix size, a number of processes, an engine and a distribution.
+ *
+ * The side of the blocks follows from the grid, b = ceil(n/q), so choosing the grid
+ * also chooses the size of the local products.
+ */
+typedef struct {
+    int q; /**< The side of each layer of the procs cube */
+    int m; /**< The depth of procs cube */
+    int mc; /**< Rows of the packed panel of A */
+    int kc; /**< Depth of the packed panels */
+    int nc; /**< Columns of the packed panel of B */
+    double time; /**< Median computation time of the configuration */
+} TuningEntry;
+
+/**
+ * @brief Builds the key identifying the machine.
+ *
+ * The key joins the host name, the element type and the code path of the kernel,
+ * since each of them changes the best configuration.
+ *
+ * @param machine Buffer of TUNING_MACHINE_LEN characters receiving the key.
+ */
+void tuningMachine(char* machine);
+
+/**
+ * @brief Looks up the configuration stored for a machine, a size, a number of processes,
+ * an engine and a distribution.
+ *
+ * @param filename Path of the tuning file.
+ * @param machine Key of the machine.
+ * @param n Size of the matrix.
+ * @param p Number of processes.
+ * @param engine Strategy used for the shifts.
+ * @param distribution Strategy used to place the blocks.
+ * @param entry Pointer to the configuration to fill.
+ * @return 0 if a configuration was found, 1 otherwise.
+ */
+int lookupTuning(const char* filename, const char* machine, int n, int p, enum Engine engine, enum DistributionMode distribution, TuningEntry* entry);
+
+/**
+ * @brief Stores the configuration for a machine, a size, a number of processes, an engine
+ * and a distribution.
+ *
+ * A configuration already stored with the same key is replaced.
+ *
+ * @param filename Path of the tuning file.
+ * @param machine Key of the machine.
+ * @param n Size of the matrix.
+ * @param p Number of processes.
+ * @param engine Strategy used for the shifts.
+ * @param distribution Strategy used to place the blocks.
+ * @param entry Configuration to store.
+ * @return 0 on success, 1 on failure.
+ */
+int storeTuning(const char* filename, const char* machine, int n, int p, enum Engine engine, enum DistributionMode distribution, const TuningEntry* entry);
+
+#endif // TUNINGCACHE_H